@@ -0,0 +1,123 @@
+//==============================================================================
+/// \file AutoUnits/ConversionPlan.cpp
+///
+/// Source file for the AutoUnits::ConversionPlan class.
+///
+//==============================================================================
+
+#include <cassert>
+
+#include "ConversionPlan.h"
+#include "Converter.h"
+#include "Types/Conversion.h"
+
+namespace AutoUnits
+{
+
+namespace
+{
+
+//==============================================================================
+/// Get the size of an element of the given type.
+///
+/// \param [in] type The type.
+///
+/// \return The size in bytes.
+///
+std::size_t ElementSize( ConversionPlan::ElementType type )
+{
+    return ( type == ConversionPlan::Float ) ? sizeof( float ) :
+        sizeof( double );
+}
+
+}
+
+//==============================================================================
+/// Constructor.
+///
+/// \param [in] offset The byte offset of the field within the record.
+/// \param [in] type The type of the field.
+/// \param [in] from The unit the field is stored in.
+/// \param [in] to The unit to convert the field to.
+///
+ConversionPlan::Field::Field( std::size_t offset, ElementType type,
+    const QString& from, const QString& to ) :
+    offset( offset ), type( type ), from( from ), to( to )
+{
+}
+
+//==============================================================================
+/// Constructor.
+///
+/// \param [in] converter The converter to get the field conversions from.
+/// \param [in] stride The distance in bytes between consecutive records.
+/// \param [in] fields The fields to convert.
+///
+ConversionPlan::ConversionPlan( const Converter& converter,
+    std::size_t stride, const QList<Field>& fields ) :
+    m_stride( stride )
+{
+    m_steps.reserve( fields.count() );
+
+    for ( int i = 0; i < fields.count(); ++i )
+    {
+        const Field& field( fields[i] );
+
+        assert( field.offset + ElementSize( field.type ) <= stride );
+        assert( converter.CanConvert( field.from, field.to ) );
+
+        Step step;
+        step.offset = field.offset;
+        step.type = field.type;
+        step.scale = 1.0;
+        step.shift = 0.0;
+        step.conv_p = converter.GetConversion( field.from, field.to );
+
+        if ( GetAffine( *step.conv_p, &step.scale, &step.shift ) )
+        {
+            step.conv_p = NULL;
+        }
+
+        m_steps.append( step );
+    }
+}
+
+//==============================================================================
+/// Convert the fields of an array of records in place.
+///
+/// \param [in,out] records_p The first record.
+/// \param [in] count The number of records.
+///
+void ConversionPlan::Apply( void *records_p, int count ) const
+{
+    char *record_p = static_cast<char*>( records_p );
+    const Step *steps_p = m_steps.constData();
+    const int step_count = m_steps.count();
+
+    for ( int i = 0; i < count; ++i, record_p += m_stride )
+    {
+        for ( int j = 0; j < step_count; ++j )
+        {
+            const Step& step( steps_p[j] );
+            char *field_p = record_p + step.offset;
+
+            double value = ( step.type == Float ) ?
+                *reinterpret_cast<float*>( field_p ) :
+                *reinterpret_cast<double*>( field_p );
+
+            value = step.conv_p ? step.conv_p->Eval( value ) :
+                step.scale * value + step.shift;
+
+            if ( step.type == Float )
+            {
+                *reinterpret_cast<float*>( field_p ) = float( value );
+            }
+            else
+            {
+                *reinterpret_cast<double*>( field_p ) = value;
+            }
+        }
+    }
+}
+
+} // namespace AutoUnits
@@ -0,0 +1,92 @@
+#ifndef AUTO_UNITS_CONVERSION_PLAN_H
+#define AUTO_UNITS_CONVERSION_PLAN_H
+//==============================================================================
+/// \file AutoUnits/ConversionPlan.h
+///
+/// Header file for the AutoUnits::ConversionPlan class.
+///
+//==============================================================================
+
+#include <cstddef>
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+namespace AutoUnits
+{
+
+namespace Conversions { class Conversion; }
+using Conversions::Conversion;
+class Converter;
+
+//==============================================================================
+/// A precomputed set of conversions for the fields of an array of records.
+/// The plan is built once from a description of the fields and can then
+/// convert any number of records in a single pass.
+///
+/// \note The plan uses conversions cached by the converter, so the converter
+///       must outlive the plan, and the plan must be rebuilt if a unit it 
+///       converts is redefined.
+///
+class ConversionPlan
+{
+public:
+    /// The types of fields the plan can convert.
+    enum ElementType
+    {
+        Float,
+        Double
+    };
+
+    //==========================================================================
+    /// Describes one field of a record.
+    ///
+    struct Field
+    {
+        Field( std::size_t offset, ElementType type, const QString& from,
+            const QString& to );
+
+        /// The byte offset of the field within the record.
+        std::size_t offset;
+        /// The type of the field.
+        ElementType type;
+        /// The unit the field is stored in.
+        QString from;
+        /// The unit to convert the field to.
+        QString to;
+    };
+
+    ConversionPlan( const Converter& converter, std::size_t stride,
+        const QList<Field>& fields );
+
+    void Apply( void *records_p, int count ) const;
+
+private:
+    //==========================================================================
+    /// The compiled conversion for one field.
+    ///
+    struct Step
+    {
+        /// The byte offset of the field within the record.
+        std::size_t offset;
+        /// The type of the field.
+        ElementType type;
+        /// The scale, if the conversion is affine.
+        double scale;
+        /// The offset, if the conversion is affine.
+        double shift;
+        /// The conversion, if it isn't affine; otherwise NULL.
+        const Conversion *conv_p;
+    };
+
+    /// The distance in bytes between consecutive records.
+    std::size_t m_stride;
+
+    /// The steps, one per field.
+    QVector<Step> m_steps;
+};
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_CONVERSION_PLAN_H
@@ -5,13 +5,25 @@
 ///
 //==============================================================================
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <QDataStream>
+#include <QFile>
+#include <QVarLengthArray>
+#include <QVector>
 
 #include "Converter.h"
+#include "DerivationParser.h"
 #include "Dimension.h"
 #include "Types/Conversion.h"
 #include "Unit.h"
 #include "UnitSystem.h"
+#include "Util/ConversionStream.h"
+#include "Util/Error.h"
+#include "Util/File.h"
 
 namespace AutoUnits
 {
@@ -20,37 +32,317 @@ namespace AutoUnits
 namespace
 {
 
+/// Identifies a saved conversion cache file.
+const quint32 CACHE_MAGIC = 0x41554343;
+
+/// The version of the saved conversion cache format.
+const quint32 CACHE_VERSION = 1;
+
+/// The number of parsed expressions kept before the cache is emptied.
+const int MAX_EXPRESSIONS = 256;
+
 //==============================================================================
-/// Compute the conversion factor from \c from to \c to.
+/// Reduce a compound unit expression to a dimension and a scale factor to the
+/// base unit of that dimension. Every unit in the expression must convert to
+/// its base unit by a pure scale factor; units with an offset (such as 
+/// temperatures) have no meaning in a product.
 /// 
 /// \param [in] system_p The unit system.
-/// \param [in] from The source unit.
-/// \param [in] to The destination unit.
+/// \param [in] text The expression.
+/// \param [out] dim_pp The dimension of the expression.
+/// \param [out] scale_p The scale factor to the base unit.
+/// \param [out] factor_dims_p The dimensions of the units in the expression.
+/// 
+/// \return True if the expression could be reduced.
 /// 
-Conversion::AutoPtr Compute( 
-    const UnitSystem *system_p, const QString& from, const QString& to )
+bool ReduceExpression( const UnitSystem *system_p, const QString& text, 
+    const Dimension **dim_pp, double *scale_p, 
+    QList<const Dimension*> *factor_dims_p )
 {
-    const Unit *from_p( system_p->GetUnit( from ) );
-    const Unit *to_p( system_p->GetUnit( to ) );
+    DimensionId factors;
+    try
+    {
+        factors = ParseDerivation( text );
+    }
+    catch ( Util::Error& )
+    {
+        return false;
+    }
+
+    PackedDimensionId id;
+    double scale = 1.0;
+
+    for ( DimensionId::const_iterator it = factors.begin(); 
+        it != factors.end(); ++it )
+    {
+        if ( it.value() == 0 )
+        {
+            continue;
+        }
+
+        const Unit *unit_p = system_p->GetUnit( it.key() );
+        if ( !unit_p )
+        {
+            unit_p = system_p->GetUnitBySymbol( it.key() );
+        }
+
+        double unit_scale = 0.0;
+        double unit_offset = 0.0;
+
+        if ( !unit_p || 
+            !GetAffine( *unit_p->ToBase(), &unit_scale, &unit_offset ) ||
+            ( unit_offset != 0.0 ) )
+        {
+            return false;
+        }
+
+        id = id * ( unit_p->GetDimension()->PackedId() ^ it.value() );
+        scale *= std::pow( unit_scale, it.value() );
+        factor_dims_p->append( unit_p->GetDimension() );
+    }
 
-    assert( from_p );
-    assert( to_p );
-    assert( from_p->GetDimension() == to_p->GetDimension() );
-    
-    return Compose( *to_p->FromBase(), *from_p->ToBase() );
+    *dim_pp = system_p->GetDimension( id );
+    *scale_p = scale;
+    return *dim_pp != NULL;
 }
 
+//==============================================================================
+/// Apply a conversion to an array of values.
+/// 
+/// \param [in] conv The conversion.
+/// \param [in] values_p The values to convert.
+/// \param [in] count The number of values.
+/// \param [out] results_p The converted values.
+/// 
+void ConvertArray( const Conversion& conv, const double *values_p, int count,
+    double *results_p )
+{
+    double scale = 0.0;
+    double offset = 0.0;
+
+    if ( GetAffine( conv, &scale, &offset ) )
+    {
+        for ( int i = 0; i < count; ++i )
+        {
+            results_p[i] = scale * values_p[i] + offset;
+        }
+        return;
+    }
+
+    for ( int i = 0; i < count; ++i )
+    {
+        results_p[i] = conv.Eval( values_p[i] );
+    }
+}
+
+/// A unit and its scale factor to the base unit.
+typedef QPair<double, const Unit*> ScaledUnit;
+
+//==============================================================================
+/// Order units by scale factor.
+/// 
+/// \param [in] lhs The left hand side.
+/// \param [in] rhs The right hand side.
+/// 
+/// \return True if the left hand side has the smaller scale factor.
+/// 
+bool LessScale( const ScaledUnit& lhs, const ScaledUnit& rhs )
+{
+    return lhs.first < rhs.first;
 }
 
+}
+
+//==============================================================================
+/// The versions of the dimensions, and if needed the unit system, that a 
+/// cached result was computed from. The result is stale once any of them 
+/// changes.
+/// 
+struct Converter::Stamp
+{
+    //==========================================================================
+    /// Constructor.
+    /// 
+    Stamp() : 
+        system_p( NULL ), system_version( 0 )
+    {
+    }
+
+    //==========================================================================
+    /// Add a dependency on the units of a dimension.
+    /// 
+    /// \param [in] dim_p The dimension.
+    /// 
+    void Add( const Dimension *dim_p )
+    {
+        dims.append( qMakePair( dim_p, dim_p->Version() ) );
+    }
+
+    //==========================================================================
+    /// Add a dependency on the names the unit system defines.
+    /// 
+    /// \param [in] system_p The unit system.
+    /// 
+    void Add( const UnitSystem *system_p )
+    {
+        Stamp::system_p = system_p;
+        system_version = system_p->Version();
+    }
+
+    //==========================================================================
+    /// Add the dependencies of another stamp.
+    /// 
+    /// \param [in] stamp The other stamp.
+    /// 
+    void Add( const Stamp& stamp )
+    {
+        dims += stamp.dims;
+        if ( stamp.system_p && 
+            ( !system_p || ( stamp.system_version < system_version ) ) )
+        {
+            system_p = stamp.system_p;
+            system_version = stamp.system_version;
+        }
+    }
+
+    //==========================================================================
+    /// Check whether the dependencies are unchanged.
+    /// 
+    /// \return True if the result is still current.
+    /// 
+    bool IsCurrent() const
+    {
+        if ( system_p && ( system_p->Version() != system_version ) )
+        {
+            return false;
+        }
+
+        for ( int i = 0; i < dims.count(); ++i )
+        {
+            if ( dims[i].first->Version() != dims[i].second )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// The unit system, if the result depends on the names it defines.
+    const UnitSystem *system_p;
+    /// The version of the unit system.
+    quint32 system_version;
+    /// The dimensions and their versions.
+    QVector<QPair<const Dimension*, quint32> > dims;
+};
+
+//==============================================================================
+/// A cached conversion.
+/// 
+struct Converter::CacheEntry
+{
+    //==========================================================================
+    /// Constructor.
+    /// 
+    /// \param [in] conv_p The conversion.
+    /// \param [in] stamp What the conversion was computed from.
+    /// 
+    CacheEntry( Conversion::AutoPtr conv_p, const Stamp& stamp ) : 
+        conv_p( conv_p ), stamp( stamp )
+    {
+    }
+
+    /// The conversion.
+    Conversion::AutoPtr conv_p;
+    /// What the conversion was computed from.
+    Stamp stamp;
+};
+
+//==============================================================================
+/// The coefficients for converting every unit of a dimension to one target 
+/// unit, indexed by Unit::Index(). Units whose conversion to the target is 
+/// affine are converted as scale * value + offset; the rest use the composed
+/// conversion.
+/// 
+struct Converter::GatherTable
+{
+    //==========================================================================
+    /// Destructor.
+    /// 
+    ~GatherTable()
+    {
+        qDeleteAll( conversions );
+    }
+
+    /// The scale of each slot's conversion.
+    QVector<double> scales;
+    /// The offset of each slot's conversion.
+    QVector<double> offsets;
+    /// Our copy of the conversion for each slot that isn't affine, or NULL. 
+    /// The converter's cached conversions may be dropped or recomputed 
+    /// while the table is still current, so the table owns its own.
+    QVector<const Conversion*> conversions;
+    /// Maps unit outside the dimension's unit list (such as a prefixed 
+    /// unit) -> its slot. These slots follow the dimension's units, and are
+    /// added as the units are met.
+    QHash<const Unit*, int> extra_slots;
+    /// The target unit's conversion from the base unit, if it is affine.
+    double to_scale;
+    /// The target unit's offset from the base unit, if it is affine.
+    double to_offset;
+    /// Whether the target unit's conversion from the base unit is affine.
+    bool to_affine;
+    /// The version of the dimension the table was built for.
+    quint32 version;
+};
+
+//==============================================================================
+/// A compound unit expression reduced to a dimension and the conversions to 
+/// and from the dimension's base unit.
+/// 
+struct Converter::Expression
+{
+    //==========================================================================
+    /// Constructor.
+    /// 
+    /// \param [in] dim_p The dimension of the expression.
+    /// \param [in] scale The scale factor to the base unit.
+    /// 
+    Expression( const Dimension *dim_p, double scale ) : 
+        dim_p( dim_p ), 
+        to_base_p( Conversion::ScaleFactor( scale ) ),
+        from_base_p( Conversion::ScaleFactor( 1.0 / scale ) )
+    {
+    }
+
+    /// The dimension.
+    const Dimension *dim_p;
+    /// The conversion to the base unit.
+    Conversion::AutoPtr to_base_p;
+    /// The conversion from the base unit.
+    Conversion::AutoPtr from_base_p;
+    /// What the expression was reduced from.
+    Stamp stamp;
+};
+
+//==============================================================================
+/// The linear units of a dimension, sorted by their scale factor to the base
+/// unit. Units with the same scale factor appear once.
+/// 
+struct Converter::ScaleTable
+{
+    /// The scale factor of each unit, in ascending order.
+    QVector<double> scales;
+    /// The units.
+    QVector<const Unit*> units;
+    /// The version of the dimension the table was built for.
+    quint32 version;
+};
+
 //==============================================================================
 /// Constructor.
 ///
 /// \param [in] system_p The unit system.
 /// 
-/// \note This assumes that the unit system doesn't change for the lifetime
-///       of the converter. 
-/// 
-/// 
 Converter::Converter( const UnitSystem *system_p ) : 
     m_system_p( system_p )
 {
@@ -62,6 +354,9 @@ Converter::Converter( const UnitSystem *system_p ) :
 Converter::~Converter()
 {
     qDeleteAll( m_cache );
+    qDeleteAll( m_gather_cache );
+    qDeleteAll( m_scale_tables );
+    qDeleteAll( m_expressions );
 }
 
 //==============================================================================
@@ -74,21 +369,7 @@ Converter::~Converter()
 /// 
 bool Converter::CanConvert( const QString& from, const QString& to ) const
 {
-    if ( m_cache.contains( CacheKey( from, to ) ) )
-    {
-        return true;
-    }
-
-    const Unit *from_p = m_system_p->GetUnit( from );
-    const Unit *to_p = m_system_p->GetUnit( to );
-
-    if ( to_p->GetDimension() == from_p->GetDimension() )
-    {
-        m_cache.insert( 
-            CacheKey( from, to ), Compute( m_system_p, from, to ).release() );
-        return true;
-    }
-    return false;
+    return Lookup( from, to ) != NULL;
 }
 
 //==============================================================================
@@ -113,24 +394,881 @@ double Converter::Convert(
 /// \param[in] from The source unit type.
 /// \param[in] to The desired unit type.
 /// 
-/// \return The conversion, if it exists.
+/// \return The conversion, or NULL if it doesn't exist. The conversion is 
+///         valid until a unit it was computed from is redefined.
 /// 
 const Conversion *Converter::GetConversion( 
     const QString& from, const QString& to ) const
+{
+    const CacheEntry *entry_p = Lookup( from, to );
+    return entry_p ? entry_p->conv_p.get() : NULL;
+}
+
+//==============================================================================
+/// Convert an array of values from one unit to another.
+/// 
+/// \param [in] from The source unit.
+/// \param [in] to The target unit.
+/// \param [in] values_p The values to convert.
+/// \param [in] count The number of values.
+/// \param [out] results_p The converted values.
+/// 
+void Converter::Convert( const QString& from, const QString& to, 
+    const double *values_p, int count, double *results_p ) const
+{
+    assert( CanConvert( from, to ) );
+    ConvertArray( *GetConversion( from, to ), values_p, count, results_p );
+}
+
+//==============================================================================
+/// Convert an array of values from one unit into several other units in a 
+/// single pass over the input. Each value is converted to the base unit once
+/// and then from the base unit into every target.
+/// 
+/// \param [in] from The source unit, which may be anything Convert() 
+///        accepts.
+/// \param [in] to The target units. These must all have the same dimension as
+///        the source unit.
+/// \param [in] values_p The values to convert.
+/// \param [in] count The number of values.
+/// \param [out] results_pp One output array of \c count values for each 
+///        target unit, in the same order as \c to.
+/// 
+/// \return True if the values were converted. False if a unit couldn't be 
+///         resolved or has another dimension than the source unit, in which
+///         case nothing is written.
+/// 
+bool Converter::ConvertToMany( const QString& from, const QStringList& to, 
+    const double *values_p, int count, double * const *results_pp ) const
+{
+    TrimExpressions();
+
+    const Dimension *from_dim_p = NULL;
+    const Conversion *to_base_p = NULL;
+    const Conversion *unused_p = NULL;
+    Stamp stamp;
+    QString canonical;
+    if ( !Resolve( from, &from_dim_p, &to_base_p, &unused_p, &stamp, 
+            &canonical ) )
+    {
+        return false;
+    }
+
+    double to_base_scale = 0.0;
+    double to_base_offset = 0.0;
+    bool to_base_affine = 
+        GetAffine( *to_base_p, &to_base_scale, &to_base_offset );
+
+    const int targets = to.count();
+    QVarLengthArray<const Conversion*, 8> from_base( targets );
+    QVarLengthArray<double, 8> scales( targets );
+    QVarLengthArray<double, 8> offsets( targets );
+    QVarLengthArray<bool, 8> affine( targets );
+    bool all_affine = to_base_affine;
+
+    for ( int t = 0; t < targets; ++t )
+    {
+        const Dimension *to_dim_p = NULL;
+        if ( !Resolve( to[t], &to_dim_p, &unused_p, &from_base[t], &stamp, 
+                &canonical ) || 
+            ( to_dim_p != from_dim_p ) )
+        {
+            return false;
+        }
+
+        affine[t] = GetAffine( *from_base[t], &scales[t], &offsets[t] );
+        all_affine = all_affine && affine[t];
+    }
+
+    if ( all_affine )
+    {
+        for ( int i = 0; i < count; ++i )
+        {
+            const double base = to_base_scale * values_p[i] + to_base_offset;
+            for ( int t = 0; t < targets; ++t )
+            {
+                results_pp[t][i] = scales[t] * base + offsets[t];
+            }
+        }
+        return true;
+    }
+
+    for ( int i = 0; i < count; ++i )
+    {
+        const double base = to_base_affine ? 
+            to_base_scale * values_p[i] + to_base_offset : 
+            to_base_p->Eval( values_p[i] );
+
+        for ( int t = 0; t < targets; ++t )
+        {
+            results_pp[t][i] = affine[t] ? 
+                scales[t] * base + offsets[t] : from_base[t]->Eval( base );
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+/// Convert an array of values with individual source units into one target 
+/// unit. The per-unit coefficients are gathered from a table for the target
+/// unit, so no lookup by name is needed for each value. Units outside the 
+/// dimension's unit list, such as prefixed units, get slots in the table the
+/// first time they are met.
+/// 
+/// The loop is scalar on purpose: a gather from the coefficient table is 
+/// one indexed multiply-add per value, which the compiler can schedule 
+/// without hand-written vector code.
+/// 
+/// \param [in] from_pp The source unit of each value.
+/// \param [in] to The target unit.
+/// \param [in] values_p The values to convert.
+/// \param [in] count The number of values.
+/// \param [out] results_p The converted values. A value whose unit has 
+///        another dimension than the target unit, or all of them if the 
+///        target unit is unknown, is NaN.
+/// 
+void Converter::ConvertFromMany( const Unit * const *from_pp, 
+    const QString& to, const double *values_p, int count, 
+    double *results_p ) const
+{
+    const Unit *to_p = m_system_p->GetUnit( to );
+    if ( !to_p )
+    {
+        std::fill( results_p, results_p + count, 
+            std::numeric_limits<double>::quiet_NaN() );
+        return;
+    }
+
+    const Dimension *dim_p = to_p->GetDimension();
+    GatherTable *table_p = GetGatherTable( to_p );
+    const double *scales_p = table_p->scales.constData();
+    const double *offsets_p = table_p->offsets.constData();
+    const Conversion * const *conversions_p = 
+        table_p->conversions.constData();
+
+    // The last unit met that isn't in the dimension's unit list, and its 
+    // slot, so a run of such units only looks up the slot once.
+    const Unit *extra_p = NULL;
+    int extra_slot = -1;
+
+    for ( int i = 0; i < count; ++i )
+    {
+        const Unit *from_p = from_pp[i];
+        if ( from_p->GetDimension() != dim_p )
+        {
+            results_p[i] = std::numeric_limits<double>::quiet_NaN();
+            continue;
+        }
+
+        int k = from_p->Index();
+        if ( k < 0 )
+        {
+            if ( from_p != extra_p )
+            {
+                extra_p = from_p;
+                extra_slot = GetGatherSlot( table_p, from_p, to_p );
+
+                // Adding a slot may have moved the table's arrays.
+                scales_p = table_p->scales.constData();
+                offsets_p = table_p->offsets.constData();
+                conversions_p = table_p->conversions.constData();
+            }
+            k = extra_slot;
+        }
+
+        results_p[i] = conversions_p[k] ? 
+            conversions_p[k]->Eval( values_p[i] ) : 
+            scales_p[k] * values_p[i] + offsets_p[k];
+    }
+}
+
+//==============================================================================
+/// Convert an array of values where every value has its own source and target
+/// unit. The values are grouped by unit pair so that each distinct conversion
+/// is looked up once and applied to its whole group.
+/// 
+/// \param [in] from_pp The source unit of each value.
+/// \param [in] to_pp The target unit of each value.
+/// \param [in] values_p The values to convert.
+/// \param [in] count The number of values.
+/// \param [out] results_p The converted values. A value whose units have 
+///        different dimensions is NaN.
+/// 
+void Converter::ConvertMixed( const Unit * const *from_pp, 
+    const Unit * const *to_pp, const double *values_p, int count, 
+    double *results_p ) const
+{
+    typedef QPair<const Unit*, const Unit*> Pair;
+
+    // Assign every value to the group for its unit pair. Runs of the same
+    // pair are common, so check the previous pair before hashing.
+    QHash<Pair, int> group_ids;
+    QVector<Pair> pairs;
+    QVector<int> groups( count );
+    QVector<int> sizes;
+
+    for ( int i = 0; i < count; ++i )
+    {
+        Pair pair( from_pp[i], to_pp[i] );
+        int group;
+
+        if ( ( i > 0 ) && ( pairs[groups[i - 1]] == pair ) )
+        {
+            group = groups[i - 1];
+        }
+        else 
+        {
+            QHash<Pair, int>::const_iterator it = group_ids.find( pair );
+            if ( it != group_ids.end() )
+            {
+                group = it.value();
+            }
+            else
+            {
+                group = pairs.count();
+                group_ids.insert( pair, group );
+                pairs.append( pair );
+                sizes.append( 0 );
+            }
+        }
+
+        groups[i] = group;
+        sizes[group]++;
+    }
+
+    // Partition the values by group.
+    QVector<int> starts( pairs.count() );
+    for ( int g = 0, start = 0; g < pairs.count(); ++g )
+    {
+        starts[g] = start;
+        start += sizes[g];
+    }
+
+    QVector<int> order( count );
+    QVector<double> gathered( count );
+    {
+        QVector<int> next( starts );
+        for ( int i = 0; i < count; ++i )
+        {
+            const int j = next[groups[i]]++;
+            order[j] = i;
+            gathered[j] = values_p[i];
+        }
+    }
+
+    // Convert each group in one batch and scatter the results back.
+    QVector<double> converted( count );
+    for ( int g = 0; g < pairs.count(); ++g )
+    {
+        const Conversion *conv_p = ( pairs[g].first->GetDimension() == 
+            pairs[g].second->GetDimension() ) ? GetConversion( 
+                pairs[g].first->Name(), pairs[g].second->Name() ) : NULL;
+
+        if ( conv_p )
+        {
+            ConvertArray( *conv_p, gathered.constData() + starts[g], 
+                sizes[g], converted.data() + starts[g] );
+        }
+        else
+        {
+            std::fill( converted.begin() + starts[g], 
+                converted.begin() + starts[g] + sizes[g], 
+                std::numeric_limits<double>::quiet_NaN() );
+        }
+    }
+
+    for ( int j = 0; j < count; ++j )
+    {
+        results_p[order[j]] = converted[j];
+    }
+}
+
+//==============================================================================
+/// Find the most readable unit for a value: the largest unit in which the 
+/// value's magnitude is at least one, or the smallest unit if there is none.
+/// The candidates are the linear units of the value's dimension, so with 
+/// Millimeter, Meter and Kilometer defined, 0.0003 Meter picks Millimeter
+/// and 5e6 Meter picks Kilometer.
+/// 
+/// \param [in] unit The unit the value is in.
+/// \param [in] value The value.
+/// 
+/// \return The unit, or NULL if the unit is unknown or isn't linear (such 
+///         as a temperature with an offset).
+/// 
+const Unit *Converter::BestUnit( const QString& unit, double value ) const
+{
+    return BestUnit( unit, &value, 1 );
+}
+
+//==============================================================================
+/// Find the most readable unit for an array of values, as for BestUnit() on
+/// a value of their median or maximum magnitude. The dimension's units are 
+/// sorted by scale once, so each call costs a binary search once the 
+/// magnitude is known.
+/// 
+/// \param [in] unit The unit the values are in.
+/// \param [in] values_p The values.
+/// \param [in] count The number of values.
+/// \param [in] magnitude How to summarize the values' magnitudes.
+/// 
+/// \return The unit, or NULL if the unit is unknown or isn't linear.
+/// 
+const Unit *Converter::BestUnit( const QString& unit, const double *values_p, 
+    int count, Magnitude magnitude ) const
+{
+    TrimExpressions();
+
+    const Dimension *dim_p;
+    const Conversion *to_base_p;
+    const Conversion *from_base_p;
+    Stamp stamp;
+    QString canonical;
+    double scale = 0.0;
+    double offset = 0.0;
+
+    if ( !Resolve( unit, &dim_p, &to_base_p, &from_base_p, &stamp, 
+            &canonical ) || 
+        !GetAffine( *to_base_p, &scale, &offset ) || ( offset != 0.0 ) )
+    {
+        return NULL;
+    }
+
+    const ScaleTable& table = *GetScaleTable( dim_p );
+    if ( table.units.isEmpty() )
+    {
+        return NULL;
+    }
+
+    double x = 0.0;
+    if ( count > 0 )
+    {
+        QVector<double> magnitudes( count );
+        for ( int i = 0; i < count; ++i )
+        {
+            magnitudes[i] = std::abs( values_p[i] );
+        }
+
+        if ( magnitude == Maximum )
+        {
+            x = *std::max_element( magnitudes.begin(), magnitudes.end() );
+        }
+        else
+        {
+            std::nth_element( magnitudes.begin(), 
+                magnitudes.begin() + count / 2, magnitudes.end() );
+            x = magnitudes[count / 2];
+        }
+    }
+
+    // Zero, infinity and NaN have no better unit than the base unit.
+    x *= std::abs( scale );
+    if ( !( x > 0.0 ) || ( x > std::numeric_limits<double>::max() ) )
+    {
+        x = 1.0;
+    }
+
+    // Allow for rounding, so that a value of exactly one unit picks it.
+    const double *begin_p = table.scales.constData();
+    const double *end_p = begin_p + table.scales.count();
+    const int index = 
+        std::upper_bound( begin_p, end_p, x * ( 1.0 + 1.0e-9 ) ) - begin_p;
+
+    return table.units[qMax( index - 1, 0 )];
+}
+
+//==============================================================================
+/// Save the cached conversions to a file so that a later converter for the
+/// same unit system can skip computing them.
+/// 
+/// \param [in] path The path of the file to write.
+/// 
+/// \return True if the file was written.
+/// 
+bool Converter::Save( const QString& path ) const
+{
+    QByteArray contents;
+    QDataStream out( &contents, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+
+    // Stale conversions don't match the fingerprint, so leave them out.
+    QList<Cache::const_iterator> current;
+    for ( Cache::const_iterator it = m_cache.begin(); it != m_cache.end(); 
+        ++it )
+    {
+        if ( it.value()->stamp.IsCurrent() )
+        {
+            current.append( it );
+        }
+    }
+
+    out << CACHE_MAGIC << CACHE_VERSION << m_system_p->Fingerprint();
+    out << quint32( current.count() );
+
+    for ( int i = 0; i < current.count(); ++i )
+    {
+        out << current[i].key().first << current[i].key().second 
+            << *current[i].value()->conv_p;
+    }
+
+    return Util::ReplaceFile( path, contents );
+}
+
+//==============================================================================
+/// Load conversions saved by Save() into the cache. The file is only used if
+/// it was saved for a unit system with the same contents as ours; otherwise 
+/// it is ignored and conversions are computed on demand as usual.
+/// 
+/// \param [in] path The path of the file to read.
+/// 
+/// \return True if the file was loaded.
+/// 
+bool Converter::Load( const QString& path )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        return false;
+    }
+
+    QByteArray contents;
+    uchar *data_p = file.map( 0, file.size() );
+    if ( data_p )
+    {
+        contents = QByteArray::fromRawData( 
+            reinterpret_cast<const char*>( data_p ), file.size() );
+    }
+    else
+    {
+        contents = file.readAll();
+    }
+
+    QDataStream in( contents );
+    in.setVersion( QDataStream::Qt_4_6 );
+
+    quint32 magic;
+    quint32 version;
+    QByteArray fingerprint;
+    quint32 count;
+    in >> magic >> version >> fingerprint >> count;
+
+    if ( ( in.status() != QDataStream::Ok ) || ( magic != CACHE_MAGIC ) ||
+        ( version != CACHE_VERSION ) || 
+        ( fingerprint != m_system_p->Fingerprint() ) )
+    {
+        return false;
+    }
+
+    QHash<CacheKey, Conversion*> loaded;
+    for ( quint32 i = 0; i < count; ++i )
+    {
+        QString from;
+        QString to;
+        Conversion::AutoPtr conv_p;
+        in >> from >> to >> conv_p;
+
+        if ( in.status() != QDataStream::Ok )
+        {
+            qDeleteAll( loaded );
+            return false;
+        }
+
+        loaded.insert( CacheKey( from, to ), conv_p.release() );
+    }
+
+    for ( QHash<CacheKey, Conversion*>::iterator it = loaded.begin(); 
+        it != loaded.end(); ++it )
+    {
+        // Resolve the units again to stamp the conversion.
+        TrimExpressions();
+
+        const Dimension *dim_p = NULL;
+        const Conversion *unused_p = NULL;
+        Stamp stamp;
+
+        QString from;
+        QString to;
+
+        if ( m_cache.contains( it.key() ) ||
+            !Resolve( it.key().first, &dim_p, &unused_p, &unused_p, &stamp, 
+                &from ) ||
+            !Resolve( it.key().second, &dim_p, &unused_p, &unused_p, &stamp,
+                &to ) ||
+            ( CacheKey( from, to ) != it.key() ) )
+        {
+            delete it.value();
+        }
+        else
+        {
+            m_cache.insert( it.key(), 
+                new CacheEntry( Conversion::AutoPtr( it.value() ), stamp ) );
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+/// Get the cached conversion between two units, computing it if needed. 
+/// Conversions are cached under the canonical names of their units, so 
+/// looking a conversion up by other names for the same units shares it.
+/// 
+/// \param [in] from The unit to convert from.
+/// \param [in] to The unit to convert to.
+/// 
+/// \return The cache entry, or NULL if there is no such conversion.
+/// 
+Converter::CacheEntry *Converter::Lookup( const QString& from, 
+    const QString& to ) const
 {
     CacheKey key( from, to );
-    Cache::const_iterator it = m_cache.find( key );
+
+    NameCache::const_iterator name_it = m_names.find( key );
+    if ( ( name_it != m_names.end() ) && 
+        ( name_it.value().second == m_system_p->Version() ) )
+    {
+        key = name_it.value().first;
+    }
+
+    Cache::iterator it = m_cache.find( key );
     if ( it != m_cache.end() )
+    {
+        if ( it.value()->stamp.IsCurrent() )
+        {
+            return it.value();
+        }
+
+        // Something the conversion was computed from changed.
+        delete it.value();
+        m_cache.erase( it );
+    }
+
+    TrimExpressions();
+
+    const Dimension *from_dim_p = NULL;
+    const Dimension *to_dim_p = NULL;
+    const Conversion *to_base_p = NULL;
+    const Conversion *from_base_p = NULL;
+    const Conversion *unused_p = NULL;
+    QString from_name;
+    QString to_name;
+    Stamp stamp;
+
+    if ( !Resolve( from, &from_dim_p, &to_base_p, &unused_p, &stamp, 
+            &from_name ) ||
+        !Resolve( to, &to_dim_p, &unused_p, &from_base_p, &stamp, 
+            &to_name ) ||
+        ( from_dim_p != to_dim_p ) )
+    {
+        return NULL;
+    }
+
+    CacheKey canonical( from_name, to_name );
+    if ( canonical != CacheKey( from, to ) )
+    {
+        m_names.insert( CacheKey( from, to ), 
+            CanonicalKey( canonical, m_system_p->Version() ) );
+
+        it = m_cache.find( canonical );
+        if ( it != m_cache.end() )
+        {
+            if ( it.value()->stamp.IsCurrent() )
+            {
+                return it.value();
+            }
+
+            delete it.value();
+            m_cache.erase( it );
+        }
+    }
+
+    CacheEntry *entry_p = 
+        new CacheEntry( Compose( *from_base_p, *to_base_p ), stamp );
+    m_cache.insert( canonical, entry_p );
+    return entry_p;
+}
+
+//==============================================================================
+/// Get the coefficient table for converting the units of a dimension to the 
+/// given unit, building it if needed.
+/// 
+/// \param [in] to_p The target unit.
+/// 
+/// \return The table.
+/// 
+Converter::GatherTable *Converter::GetGatherTable( const Unit *to_p ) const
+{
+    GatherCache::iterator it = m_gather_cache.find( to_p );
+    if ( it != m_gather_cache.end() )
+    {
+        if ( it.value()->version == to_p->GetDimension()->Version() )
+        {
+            return it.value();
+        }
+
+        // Units were added to the dimension or redefined.
+        delete it.value();
+        m_gather_cache.erase( it );
+    }
+
+    Dimension::UnitRange units( to_p->GetDimension()->UnitsView() );
+
+    GatherTable *table_p = new GatherTable;
+    table_p->version = to_p->GetDimension()->Version();
+    table_p->to_scale = 0.0;
+    table_p->to_offset = 0.0;
+    table_p->to_affine = GetAffine( 
+        *to_p->FromBase(), &table_p->to_scale, &table_p->to_offset );
+    table_p->scales.reserve( units.count() );
+    table_p->offsets.reserve( units.count() );
+    table_p->conversions.reserve( units.count() );
+
+    for ( int k = 0; k < units.count(); ++k )
+    {
+        assert( units[k]->Index() == k );
+        AddGatherSlot( table_p, units[k], to_p );
+    }
+
+    m_gather_cache.insert( to_p, table_p );
+    return table_p;
+}
+
+//==============================================================================
+/// Get the slot of a coefficient table for a unit outside the dimension's 
+/// unit list, adding one if needed.
+/// 
+/// \param [in] table_p The table.
+/// \param [in] from_p The source unit. This must have the target unit's 
+///        dimension.
+/// \param [in] to_p The target unit.
+/// 
+/// \return The slot.
+/// 
+int Converter::GetGatherSlot( GatherTable *table_p, const Unit *from_p, 
+    const Unit *to_p ) const
+{
+    QHash<const Unit*, int>::const_iterator it = 
+        table_p->extra_slots.find( from_p );
+    if ( it != table_p->extra_slots.end() )
     {
         return it.value();
     }
 
-    Conversion *conv_p = Compute( m_system_p, from, to ).release();
+    const int slot = AddGatherSlot( table_p, from_p, to_p );
+    table_p->extra_slots.insert( from_p, slot );
+    return slot;
+}
+
+//==============================================================================
+/// Add a slot with the coefficients for a source unit to a coefficient 
+/// table.
+/// 
+/// \param [in] table_p The table.
+/// \param [in] from_p The source unit. This must have the target unit's 
+///        dimension.
+/// \param [in] to_p The target unit.
+/// 
+/// \return The slot.
+/// 
+int Converter::AddGatherSlot( GatherTable *table_p, const Unit *from_p, 
+    const Unit *to_p ) const
+{
+    double scale = 0.0;
+    double offset = 0.0;
+    const Conversion *conv_p = NULL;
 
-    m_cache.insert( key, conv_p );
-    
-    return conv_p;
+    if ( !table_p->to_affine || 
+        !GetAffine( *from_p->ToBase(), &scale, &offset ) )
+    {
+        conv_p = Compose( *to_p->FromBase(), *from_p->ToBase() ).release();
+        scale = 0.0;
+        offset = 0.0;
+    }
+    else
+    {
+        offset = table_p->to_scale * offset + table_p->to_offset;
+        scale = table_p->to_scale * scale;
+    }
+
+    table_p->scales.append( scale );
+    table_p->offsets.append( offset );
+    table_p->conversions.append( conv_p );
+    return table_p->conversions.count() - 1;
 }
 
-} // namespace AutoUnits
+//==============================================================================
+/// Get the table of linear units of a dimension sorted by scale, building it
+/// if needed.
+/// 
+/// \param [in] dim_p The dimension.
+/// 
+/// \return The table.
+/// 
+const Converter::ScaleTable *Converter::GetScaleTable( const Dimension *dim_p )
+    const
+{
+    ScaleCache::iterator it = m_scale_tables.find( dim_p );
+    if ( it != m_scale_tables.end() )
+    {
+        if ( it.value()->version == dim_p->Version() )
+        {
+            return it.value();
+        }
+
+        // Units were added to the dimension or redefined.
+        delete it.value();
+        m_scale_tables.erase( it );
+    }
+
+    Dimension::UnitRange units( dim_p->UnitsView() );
+
+    QVector<ScaledUnit> scaled;
+    for ( int i = 0; i < units.count(); ++i )
+    {
+        double scale = 0.0;
+        double offset = 0.0;
+        if ( GetAffine( *units[i]->ToBase(), &scale, &offset ) && 
+            ( offset == 0.0 ) && ( scale > 0.0 ) )
+        {
+            scaled.append( ScaledUnit( scale, units[i] ) );
+        }
+    }
+
+    std::stable_sort( scaled.begin(), scaled.end(), LessScale );
+
+    ScaleTable *table_p = new ScaleTable;
+    table_p->version = dim_p->Version();
+
+    for ( int i = 0; i < scaled.count(); ++i )
+    {
+        if ( table_p->scales.isEmpty() || 
+            ( scaled[i].first > table_p->scales.last() * ( 1.0 + 1.0e-9 ) ) )
+        {
+            table_p->scales.append( scaled[i].first );
+            table_p->units.append( scaled[i].second );
+        }
+    }
+
+    m_scale_tables.insert( dim_p, table_p );
+    return table_p;
+}
 
+//==============================================================================
+/// Get the parsed form of a compound unit expression, parsing it if needed.
+/// 
+/// \param [in] text The expression.
+/// 
+/// \return The expression, or NULL if it isn't a valid expression of units 
+///         in the system.
+/// 
+const Converter::Expression *Converter::GetExpression( const QString& text )
+    const
+{
+    ExpressionCache::iterator it = m_expressions.find( text );
+    if ( it != m_expressions.end() )
+    {
+        if ( it.value()->stamp.IsCurrent() )
+        {
+            return it.value();
+        }
+
+        delete it.value();
+        m_expressions.erase( it );
+    }
+
+    const Dimension *dim_p = NULL;
+    double scale = 1.0;
+    QList<const Dimension*> factor_dims;
+
+    // Failures aren't cached, so arbitrary bad strings can't fill the cache.
+    if ( !ReduceExpression( m_system_p, text, &dim_p, &scale, &factor_dims ) )
+    {
+        return NULL;
+    }
+
+    Expression *expr_p = new Expression( dim_p, scale );
+
+    // The factors are looked up by name or symbol, so units added later
+    // may shadow them.
+    expr_p->stamp.Add( m_system_p );
+    for ( int i = 0; i < factor_dims.count(); ++i )
+    {
+        expr_p->stamp.Add( factor_dims[i] );
+    }
+
+    m_expressions.insert( text, expr_p );
+    return expr_p;
+}
+
+//==============================================================================
+/// Empty the expression cache if it's full. The conversions Resolve hands out
+/// for an expression live in the cache, so this must only be called when 
+/// none of them are in use.
+/// 
+void Converter::TrimExpressions() const
+{
+    if ( m_expressions.count() >= MAX_EXPRESSIONS )
+    {
+        qDeleteAll( m_expressions );
+        m_expressions.clear();
+    }
+}
+
+//==============================================================================
+/// Resolve a unit name, unit symbol or compound unit expression. Names take
+/// precedence over symbols, and both take precedence over expressions.
+/// 
+/// \param [in] name The unit name, symbol or expression.
+/// \param [out] dim_pp The dimension of the unit.
+/// \param [out] to_base_pp The conversion to the base unit.
+/// \param [out] from_base_pp The conversion from the base unit.
+/// \param [in,out] stamp_p The stamp to add what the canonical name depends 
+///        on to.
+/// \param [out] canonical_p The canonical name: the unit's own name, or the
+///        expression.
+/// 
+/// \return True if the name could be resolved.
+/// 
+bool Converter::Resolve( const QString& name, const Dimension **dim_pp, 
+    const Conversion **to_base_pp, const Conversion **from_base_pp, 
+    Stamp *stamp_p, QString *canonical_p ) const
+{
+    const Unit *unit_p = m_system_p->GetUnit( name );
+    if ( !unit_p )
+    {
+        unit_p = m_system_p->GetUnitBySymbol( name );
+    }
+
+    if ( unit_p )
+    {
+        // The name of a unit in the system can't be shadowed by units added
+        // later, but the name of a prefixed unit can.
+        if ( unit_p->Index() < 0 )
+        {
+            stamp_p->Add( m_system_p );
+        }
+
+        stamp_p->Add( unit_p->GetDimension() );
+        *canonical_p = unit_p->Name();
+        *dim_pp = unit_p->GetDimension();
+        *to_base_pp = unit_p->ToBase();
+        *from_base_pp = unit_p->FromBase();
+        return true;
+    }
+
+    const Expression *expr_p = GetExpression( name );
+    if ( expr_p )
+    {
+        stamp_p->Add( expr_p->stamp );
+        *canonical_p = name;
+        *dim_pp = expr_p->dim_p;
+        *to_base_pp = expr_p->to_base_p.get();
+        *from_base_pp = expr_p->from_base_p.get();
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace AutoUnits
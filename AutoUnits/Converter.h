@@ -9,20 +9,39 @@
 
 #include <QHash>
 #include <QString>
+#include <QStringList>
 
 namespace AutoUnits
 {
 
 namespace Conversions { class Conversion; }
 using Conversions::Conversion;
+class Dimension;
+class Unit;
 class UnitSystem;
 
 //==============================================================================
-/// A class to compute and cache runtime conversions between units.
+/// A class to compute and cache runtime conversions between units. Besides 
+/// the names and symbols of units in the system, units may be given as 
+/// compound expressions of unit names or symbols such as 
+/// "Kilogram * Meter / Second^2" or "mi / h", using the same grammar as 
+/// dimension derivations.
+/// 
+/// Units may be added to the unit system, or redefined, while the converter
+/// is in use. Cached results are stamped with the versions of the dimensions
+/// they were computed from, and only results for a dimension that changed 
+/// are computed again.
 /// 
 class Converter
 {
 public:
+    /// How BestUnit() summarizes an array of values.
+    enum Magnitude
+    {
+        Median,
+        Maximum
+    };
+
     Converter( const UnitSystem *system_p );
     ~Converter();
 
@@ -32,18 +51,76 @@ public:
     const Conversion *GetConversion( const QString& from, const QString& to ) 
         const;
 
+    void Convert( const QString& from, const QString& to, 
+        const double *values_p, int count, double *results_p ) const;
+    bool ConvertToMany( const QString& from, const QStringList& to, 
+        const double *values_p, int count, double * const *results_pp ) const;
+    void ConvertFromMany( const Unit * const *from_pp, const QString& to, 
+        const double *values_p, int count, double *results_p ) const;
+    void ConvertMixed( const Unit * const *from_pp, const Unit * const *to_pp,
+        const double *values_p, int count, double *results_p ) const;
+
+    const Unit *BestUnit( const QString& unit, double value ) const;
+    const Unit *BestUnit( const QString& unit, const double *values_p, 
+        int count, Magnitude magnitude = Median ) const;
+
+    bool Save( const QString& path ) const;
+    bool Load( const QString& path );
+
 private:
-    /// Not implemented. This is here just as a reminder that system_p needs
-    /// to be immutable for the lifetime of the converter.
+    /// Not implemented. This is here just as a reminder that the converter
+    /// only reads the system; changes are made through the system's owner.
     Converter( UnitSystem* );
 
     /// Our unit system.
     const UnitSystem *m_system_p;
 
-    /// Our cached conversions.
+    /// The versions of what a cached result was computed from.
+    struct Stamp;
+
+    /// Our cached conversions, keyed by the canonical names of the units.
     typedef QPair<QString,QString> CacheKey;
-    typedef QHash<CacheKey, Conversion*> Cache;
+    struct CacheEntry;
+    typedef QHash<CacheKey, CacheEntry*> Cache;
     mutable Cache m_cache;
+
+    /// Maps other names for units (aliases, symbols and names in another 
+    /// case) -> the canonical names and the system version they were 
+    /// resolved at.
+    typedef QPair<CacheKey, quint32> CanonicalKey;
+    typedef QHash<CacheKey, CanonicalKey> NameCache;
+    mutable NameCache m_names;
+
+    CacheEntry *Lookup( const QString& from, const QString& to ) const;
+
+    /// Our cached per-unit coefficient tables, keyed by target unit.
+    struct GatherTable;
+    typedef QHash<const Unit*, GatherTable*> GatherCache;
+    mutable GatherCache m_gather_cache;
+
+    GatherTable *GetGatherTable( const Unit *to_p ) const;
+    int GetGatherSlot( GatherTable *table_p, const Unit *from_p, 
+        const Unit *to_p ) const;
+    int AddGatherSlot( GatherTable *table_p, const Unit *from_p, 
+        const Unit *to_p ) const;
+
+    /// Our cached tables of linear units sorted by scale, keyed by dimension.
+    struct ScaleTable;
+    typedef QHash<const Dimension*, ScaleTable*> ScaleCache;
+    mutable ScaleCache m_scale_tables;
+
+    const ScaleTable *GetScaleTable( const Dimension *dim_p ) const;
+
+    /// Our parsed compound unit expressions, keyed by the raw string.
+    struct Expression;
+    typedef QHash<QString, Expression*> ExpressionCache;
+    mutable ExpressionCache m_expressions;
+
+    const Expression *GetExpression( const QString& text ) const;
+    void TrimExpressions() const;
+    bool Resolve( const QString& name, const Dimension **dim_pp, 
+        const Conversion **to_base_pp, const Conversion **from_base_pp,
+        Stamp *stamp_p, QString *canonical_p ) const;
 };
 
 }
@@ -31,7 +31,16 @@ QString REDEFINED_DIM_NAME = "Redefinition of dimension \"%1\" on line %2.";
 QString REDEFINED_DIM_ID = "Definition of dimension \"%1\" on line %2 conflicts"
                            " with definition of dimension \"%3\".";
 QString UNDEFINED_DIM_NAME = "Unknown dimension \"%1\" near line %2.";
+QString TOO_MANY_BASES = "Dimension \"%1\" on line %2 needs more than %3"
+                         " base dimensions.";
 QString REDEFINED_UNIT_NAME = "Redefinition of unit \"%1\" on line %2.";
+QString UNDEFINED_DERIVATION_UNIT = "Unknown unit \"%1\" in derivation of"
+                                   " dimension \"%2\" near line %3.";
+QString REDEFINED_SYMBOL = "Redefinition of symbol \"%1\" on line %2.";
+QString UNDEFINED_SYNONYM_NAME = "Unknown dimension or unit \"%1\" near line"
+                                 " %2.";
+QString REDEFINED_SYNONYM = "Synonym \"%1\" on line %2 conflicts with an"
+                            " existing name.";
 
 }
 
@@ -42,15 +51,21 @@ namespace AutoUnits
 /// Constructor.
 /// 
 /// \param [in] path The path to the file.
+/// \param [in] base_p If not NULL, the result is an overlay of this system,
+///        and the file holds only the definitions added to it. Every section
+///        of such a file is optional. The base must outlive the result.
 /// 
-DefinitionParser::DefinitionParser( const QString& path ) : 
+DefinitionParser::DefinitionParser( const QString& path, 
+    const UnitSystem *base_p ) : 
     m_file( path )
 {
-    m_result = UnitSystem::Create();
+    m_result = base_p ? UnitSystem::CreateOverlay( base_p ) : 
+        UnitSystem::Create();
 
     try
     {
         ParseFile();
+        m_result->Freeze();
     }
     catch ( ParseError& err )
     {
@@ -119,9 +134,37 @@ void DefinitionParser::ParseFile()
 /// 
 void DefinitionParser::ParseDocument( const YAML::Node& document )
 {
-    ParseBaseDimensions( document["BaseDimensions"] );
-    ParseDerivedDimensions( document["DerivedDimensions"] );
-    ParseConvertedUnits( document["ConvertedUnits"] );
+    if ( !m_result->Base() )
+    {
+        ParseBaseDimensions( document["BaseDimensions"] );
+        ParseDerivedDimensions( document["DerivedDimensions"] );
+        ParseConvertedUnits( document["ConvertedUnits"] );
+    }
+    else
+    {
+        const YAML::Node *node_p;
+
+        if ( ( node_p = document.FindValue( "BaseDimensions" ) ) )
+        {
+            ParseBaseDimensions( *node_p );
+        }
+
+        if ( ( node_p = document.FindValue( "DerivedDimensions" ) ) )
+        {
+            ParseDerivedDimensions( *node_p );
+        }
+
+        if ( ( node_p = document.FindValue( "ConvertedUnits" ) ) )
+        {
+            ParseConvertedUnits( *node_p );
+        }
+    }
+
+    const YAML::Node *synonyms_p = document.FindValue( "Synonyms" );
+    if ( synonyms_p )
+    {
+        ParseSynonyms( *synonyms_p );
+    }
 }
 
 //==============================================================================
@@ -153,7 +196,8 @@ void DefinitionParser::ParseBaseDimension( const YAML::Node& dim )
     DimensionId id;
     id[unit_name] = 1;
 
-    (void)DefineDimension( dim.GetMark(), name, id, unit_name );
+    Dimension *dim_p = DefineDimension( dim.GetMark(), name, id, unit_name );
+    ParseSymbol( dim, dim_p->GetBaseUnit() );
 }
 
 //==============================================================================
@@ -163,9 +207,45 @@ void DefinitionParser::ParseBaseDimension( const YAML::Node& dim )
 /// 
 void DefinitionParser::ParseDerivedDimensions( const YAML::Node& dim_list )
 {
+    QList<const YAML::Node*> pending;
     for ( YAML::Iterator it = dim_list.begin(); it != dim_list.end(); ++it )
     {
-        ParseDerivedDimension( *it );
+        pending.append( &*it );
+    }
+
+    // Derivations may use the units of dimensions that come later in the 
+    // list, so keep defining the dimensions whose units are all known until
+    // none are left.
+    while ( !pending.isEmpty() )
+    {
+        QList<const YAML::Node*> deferred;
+        QString missing;
+
+        for ( int i = 0; i < pending.count(); ++i )
+        {
+            QString unit_name;
+            if ( !ParseDerivedDimension( *pending[i], &unit_name ) )
+            {
+                if ( deferred.isEmpty() )
+                {
+                    missing = unit_name;
+                }
+                deferred.append( pending[i] );
+            }
+        }
+
+        if ( deferred.count() == pending.count() )
+        {
+            const YAML::Node& dim( *deferred.first() );
+            QString name;
+            dim["name"] >> name;
+
+            const YAML::Mark& mark( dim.GetMark() );
+            throw ParseError( m_file, mark.line, UNDEFINED_DERIVATION_UNIT.
+                arg( missing ).arg( name ).arg( mark.line ) );
+        }
+
+        pending = deferred;
     }
 }
 
@@ -173,8 +253,14 @@ void DefinitionParser::ParseDerivedDimensions( const YAML::Node& dim_list )
 /// Parse a single derived dimension definition.
 /// 
 /// \param [in] dim The YAML map node for the dimension.
+/// \param [out] missing_p The first unit in the derivation that isn't 
+///        defined yet, if any.
+/// 
+/// \return True if the dimension was defined, false if the derivation uses 
+///         a unit that isn't defined yet.
 /// 
-void DefinitionParser::ParseDerivedDimension( const YAML::Node& dim )
+bool DefinitionParser::ParseDerivedDimension( const YAML::Node& dim, 
+    QString *missing_p )
 {
     QString name;
     dim["name"] >> name;
@@ -183,9 +269,63 @@ void DefinitionParser::ParseDerivedDimension( const YAML::Node& dim )
     QString derivation;
     dim["derivation"] >> derivation;
 
-    DimensionId id = ParseDerivation( derivation );
+    DimensionId id;
+    if ( !ReduceDerivation( ParseDerivation( derivation ), &id, missing_p ) )
+    {
+        return false;
+    }
 
-    (void)DefineDimension( dim.GetMark(), name, id, unit_name );
+    Dimension *dim_p = DefineDimension( dim.GetMark(), name, id, unit_name );
+    ParseSymbol( dim, dim_p->GetBaseUnit() );
+    return true;
+}
+
+//==============================================================================
+/// Reduce a parsed derivation, which is in terms of arbitrary units, to the 
+/// canonical dimension id in terms of the base units. This makes the ids of
+/// equivalent derivations equal.
+/// 
+/// \param [in] derivation The parsed derivation.
+/// \param [out] id_p The canonical id.
+/// \param [out] missing_p The first unit in the derivation that isn't 
+///        defined, if any.
+/// 
+/// \return True if every unit in the derivation is defined.
+/// 
+bool DefinitionParser::ReduceDerivation( const DimensionId& derivation, 
+    DimensionId *id_p, QString *missing_p )
+{
+    DimensionId result;
+
+    for ( DimensionId::const_iterator it = derivation.begin(); 
+        it != derivation.end(); ++it )
+    {
+        if ( it.value() == 0 )
+        {
+            continue;
+        }
+
+        const Unit *unit_p = Lookup()->GetDefinedUnit( it.key() );
+        if ( !unit_p )
+        {
+            *missing_p = it.key();
+            return false;
+        }
+
+        result = result * ( unit_p->GetDimension()->Id() ^ it.value() );
+    }
+
+    *id_p = DimensionId();
+    for ( DimensionId::const_iterator it = result.begin(); 
+        it != result.end(); ++it )
+    {
+        if ( it.value() != 0 )
+        {
+            id_p->insert( it.key(), it.value() );
+        }
+    }
+
+    return true;
 }
 
 //==============================================================================
@@ -217,7 +357,7 @@ void DefinitionParser::ParseConvertedUnit( const YAML::Node& unit )
     dim_node >> dim_name;
 
 
-    Dimension *dim_p = m_result->GetDimension( dim_name );
+    const Dimension *dim_p = Lookup()->GetDimension( dim_name );
 
     if ( !dim_p )
     {
@@ -227,9 +367,80 @@ void DefinitionParser::ParseConvertedUnit( const YAML::Node& unit )
     }
 
     Unit *unit_p = DefineUnit( unit.GetMark(), name, dim_p );
+    ParseSymbol( unit, unit_p );
     ParseConversions( unit["conversion"], unit_p );
 }
 
+//==============================================================================
+/// Parse the synonyms map from a document. Each key is the name of a 
+/// dimension or unit, and its value is the list of other names for it.
+/// 
+/// \param [in] synonym_map The YAML map node for the synonyms.
+/// 
+void DefinitionParser::ParseSynonyms( const YAML::Node& synonym_map )
+{
+    for ( YAML::Iterator it = synonym_map.begin(); it != synonym_map.end(); 
+        ++it )
+    {
+        QString name;
+        it.first() >> name;
+
+        const Dimension *dim_p = Lookup()->GetDimension( name );
+        const Unit *unit_p = Lookup()->GetDefinedUnit( name );
+
+        if ( !dim_p && !unit_p )
+        {
+            const YAML::Mark& mark( it.first().GetMark() );
+            throw ParseError( m_file, mark.line,
+                UNDEFINED_SYNONYM_NAME.arg( name ).arg( mark.line ) );
+        }
+
+        const YAML::Node& alias_list( it.second() );
+        for ( YAML::Iterator alias_it = alias_list.begin(); 
+            alias_it != alias_list.end(); ++alias_it )
+        {
+            QString alias;
+            *alias_it >> alias;
+
+            // A name that is both a dimension and a unit gets the alias for
+            // both.
+            if ( ( dim_p && !m_result->AddAlias( alias, dim_p ) ) ||
+                ( unit_p && !m_result->AddAlias( alias, unit_p ) ) )
+            {
+                const YAML::Mark& mark( alias_it->GetMark() );
+                throw ParseError( m_file, mark.line,
+                    REDEFINED_SYNONYM.arg( alias ).arg( mark.line ) );
+            }
+        }
+    }
+}
+
+//==============================================================================
+/// Parse the optional symbol of a unit and store it in the unit.
+/// 
+/// \param [in] node The YAML map node that may have a symbol.
+/// \param [in] unit_p The unit to set up.
+/// 
+void DefinitionParser::ParseSymbol( const YAML::Node& node, Unit *unit_p )
+{
+    const YAML::Node *symbol_node_p = node.FindValue( "symbol" );
+
+    if ( !symbol_node_p )
+    {
+        return;
+    }
+
+    QString symbol;
+    *symbol_node_p >> symbol;
+
+    if ( !m_result->SetSymbol( unit_p, symbol ) )
+    {
+        const YAML::Mark& mark( symbol_node_p->GetMark() );
+        throw ParseError( m_file, mark.line, 
+            REDEFINED_SYMBOL.arg( symbol ).arg( mark.line ) );
+    }
+}
+
 //==============================================================================
 /// Parse the conversion expression and store it in the unit.
 /// 
@@ -266,24 +477,28 @@ Dimension *DefinitionParser::DefineDimension( const YAML::Mark& mark,
     const QString& dim_name, const DimensionId& dim_id, 
     const QString& unit_name )
 {
-    Dimension *dim_p;
-    Unit *unit_p;
+    const Dimension *existing_p;
 
-    if ( ( dim_p = m_result->GetDimension( dim_name ) ) )
+    if ( ( existing_p = Lookup()->GetDimension( dim_name ) ) )
     {
         throw ParseError( m_file, mark.line, 
             REDEFINED_DIM_NAME.arg( dim_name ).arg( mark.line ) );
     }
 
-    if ( ( dim_p = m_result->GetDimension( dim_id ) ) )
+    if ( ( existing_p = Lookup()->GetDimension( dim_id ) ) )
     {
         throw ParseError( m_file, mark.line, REDEFINED_DIM_ID.
-            arg( dim_name ).arg( mark.line ).arg( dim_p->Name() ) );
+            arg( dim_name ).arg( mark.line ).arg( existing_p->Name() ) );
     }
 
-    dim_p = m_result->NewDimension( dim_name, dim_id );
+    Dimension *dim_p = m_result->NewDimension( dim_name, dim_id );
+    if ( !dim_p )
+    {
+        throw ParseError( m_file, mark.line, TOO_MANY_BASES.arg( dim_name ).
+            arg( mark.line ).arg( int( PackedDimensionId::MAX_BASES ) ) );
+    }
 
-    unit_p = DefineUnit( mark, unit_name, dim_p );
+    Unit *unit_p = DefineUnit( mark, unit_name, dim_p );
 
     dim_p->SetBaseUnit( unit_p );
 
@@ -295,19 +510,26 @@ Dimension *DefinitionParser::DefineDimension( const YAML::Mark& mark,
 /// errors when encountered.
 /// 
 Unit *DefinitionParser::DefineUnit( const YAML::Mark& mark, 
-    const QString& name, Dimension *dim_p )
+    const QString& name, const Dimension *dim_p )
 {
-    Unit *unit_p = m_result->GetUnit( name );
-
-    if ( unit_p )
+    if ( Lookup()->GetDefinedUnit( name ) )
     {
         throw ParseError( m_file, mark.line, REDEFINED_UNIT_NAME.
             arg( name ).arg( mark.line ) );
     }
 
-    unit_p = m_result->NewUnit( name, dim_p );
+    return m_result->NewUnit( name, dim_p );
+}
 
-    return unit_p;
+//==============================================================================
+/// Get the result for lookups. Its immutable interface falls through to the
+/// base system, so names defined there are found too.
+/// 
+/// \return The result.
+/// 
+const UnitSystem *DefinitionParser::Lookup() const
+{
+    return m_result.get();
 }
 
 //==============================================================================
@@ -35,7 +35,7 @@ class UnitSystem;
 class DefinitionParser
 {
 public:
-    DefinitionParser( const QString& path );
+    DefinitionParser( const QString& path, const UnitSystem *base_p = NULL );
     ~DefinitionParser();
 
     std::auto_ptr<const UnitSystem> TakeResult();
@@ -49,17 +49,23 @@ private:
     void ParseBaseDimension( const YAML::Node& dim );
 
     void ParseDerivedDimensions( const YAML::Node& dim_list );
-    void ParseDerivedDimension( const YAML::Node& dim );
+    bool ParseDerivedDimension( const YAML::Node& dim, QString *missing_p );
+    bool ReduceDerivation( const DimensionId& derivation, DimensionId *id_p,
+        QString *missing_p );
 
     void ParseConvertedUnits( const YAML::Node& unit_list );
     void ParseConvertedUnit( const YAML::Node& unit );
 
+    void ParseSynonyms( const YAML::Node& synonym_map );
+    void ParseSymbol( const YAML::Node& node, Unit *unit_p );
     void ParseConversions( const YAML::Node& node, Unit *unit_p );
 
     Dimension *DefineDimension( const YAML::Mark& mark, const QString& dim_name,
         const DimensionId& id, const QString& name );
     Unit *DefineUnit( 
-        const YAML::Mark& mark, const QString& name, Dimension *dim_p );
+        const YAML::Mark& mark, const QString& name, const Dimension *dim_p );
+
+    const UnitSystem *Lookup() const;
 
     /// The errors that were encountered in the parse.
     QList<ParseError> m_errors;
@@ -8,6 +8,7 @@
 #include <cassert>
 
 #include "Dimension.h"
+#include "Unit.h"
 
 namespace AutoUnits
 {
@@ -19,7 +20,18 @@ namespace AutoUnits
 /// 
 QString Dimension::Name() const
 {
-    return m_name;
+    return Util::AtomTable::Text( m_name_atom );
+}
+
+//==============================================================================
+/// Get the atom for the dimension's name, normalized as the unit system 
+/// normalizes names for lookup.
+/// 
+/// \return The atom.
+/// 
+Util::Atom Dimension::NameAtom() const
+{
+    return Util::AtomTable::Normalized( m_name_atom );
 }
 
 //==============================================================================
@@ -32,6 +44,16 @@ DimensionId Dimension::Id() const
     return m_id;
 }
 
+//==============================================================================
+/// Get the ID of the dimension in terms of the unit system's base dimensions.
+/// 
+/// \return The ID.
+/// 
+PackedDimensionId Dimension::PackedId() const
+{
+    return m_packed_id;
+}
+
 //==============================================================================
 /// Determine whether the dimension is a derived dimension.
 /// 
@@ -39,10 +61,35 @@ DimensionId Dimension::Id() const
 ///
 bool Dimension::IsDerived() const
 {
-    return m_id.count() > 1;
+    // A base dimension's id is a single base unit to the first power.
+    int terms = 0;
+    int exponent = 0;
+
+    for ( DimensionId::const_iterator it = m_id.begin(); it != m_id.end(); 
+        ++it )
+    {
+        if ( it.value() != 0 )
+        {
+            ++terms;
+            exponent = it.value();
+        }
+    }
+
+    return ( terms > 1 ) || ( ( terms == 1 ) && ( exponent != 1 ) );
 }
 
 
+//==============================================================================
+/// Get the version of the dimension. This changes whenever a unit is added to
+/// the dimension, its base unit is set, or one of its units is redefined.
+/// 
+/// \return The version.
+/// 
+quint32 Dimension::Version() const
+{
+    return m_version;
+}
+
 //==============================================================================
 /// Get the base unit for the dimension.
 /// 
@@ -69,6 +116,29 @@ QList<const Unit*> Dimension::Units() const
     return result;
 }
 
+//==============================================================================
+/// Get a view of the units in the dimension, in the order they were added,
+/// which is the order of their indices. Unlike Units(), this doesn't copy 
+/// the list.
+///
+/// \return The view, which is valid until a unit is added to the dimension.
+/// 
+Dimension::UnitRange Dimension::UnitsView() const
+{
+    const Unit * const *units_pp = m_units.constData();
+    return UnitRange( units_pp, units_pp + m_units.count() );
+}
+
+//==============================================================================
+/// Get the number of units in the dimension.
+///
+/// \return The number of units.
+/// 
+int Dimension::UnitCount() const
+{
+    return m_units.count();
+}
+
 //==============================================================================
 /// Get the base unit for the dimension.
 /// 
@@ -87,19 +157,36 @@ Unit *Dimension::GetBaseUnit()
 void Dimension::SetBaseUnit( Unit *unit_p )
 {
     assert( !m_base_unit_p );
-    assert( m_units.contains( unit_p ) );
+    assert( ( unit_p->Index() >= 0 ) && ( unit_p->Index() < m_units.count() ) &&
+        ( m_units[unit_p->Index()] == unit_p ) );
     m_base_unit_p = unit_p;
+    Touch();
 }
 
 //==============================================================================
 /// Add the unit to the dimension.
 ///
-/// \param [in] unit_p The unit to add.
+/// \param [in] unit_p The unit to add. Its index must be the dimension's 
+///        unit count, as it is for a unit being constructed in the 
+///        dimension.
 /// 
 void Dimension::AddUnit( Unit *unit_p )
 {
-    assert( !m_units.contains( unit_p ) );
+    // A unit already in the list has a smaller index.
+    assert( unit_p->Index() == m_units.count() );
     m_units.append( unit_p );
+    Touch();
+}
+
+//==============================================================================
+/// Reserve space for units about to be added to the dimension, so that 
+/// adding many units doesn't repeatedly grow the list.
+///
+/// \param [in] unit_count The total number of units the dimension will hold.
+/// 
+void Dimension::Reserve( int unit_count )
+{
+    m_units.reserve( unit_count );
 }
 
 //==============================================================================
@@ -109,7 +196,16 @@ void Dimension::AddUnit( Unit *unit_p )
 /// 
 QList<Unit*> Dimension::Units()
 {
-    return m_units;
+    return m_units.toList();
+}
+
+//==============================================================================
+/// Record that the dimension or one of its units has changed, so that
+/// results computed from the old definitions can be recognized as stale.
+/// 
+void Dimension::Touch()
+{
+    ++m_version;
 }
 
 //==============================================================================
@@ -117,9 +213,12 @@ QList<Unit*> Dimension::Units()
 /// 
 /// \param [in] name The name of the dimension.
 /// \param [in] id The ID of the dimension.
+/// \param [in] packed_id The ID in terms of the system's base dimensions.
 /// 
-Dimension::Dimension( const QString& name, const DimensionId& id ) : 
-    m_name( name ), m_id( id ), m_base_unit_p( NULL )
+Dimension::Dimension( const QString& name, const DimensionId& id, 
+    const PackedDimensionId& packed_id ) : 
+    m_name_atom( Util::AtomTable::Intern( name ) ), m_id( id ), 
+    m_packed_id( packed_id ), m_base_unit_p( NULL ), m_version( 0 )
 {
 }
 
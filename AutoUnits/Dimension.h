@@ -9,8 +9,12 @@
 
 #include <QHash>
 #include <QString>
+#include <QVector>
 
 #include "Types/DimensionId.h"
+#include "Types/PackedDimensionId.h"
+#include "Util/AtomTable.h"
+#include "Util/Range.h"
 
 namespace AutoUnits
 {
@@ -22,41 +26,60 @@ class Unit;
 class Dimension 
 {
 public:
-    
+    /// A view of the units of a dimension.
+    typedef Util::Range<const Unit*> UnitRange;
+
     //==========================================================================
     /// Immutable interface.
     //==========================================================================
     QString Name() const;
+    Util::Atom NameAtom() const;
     DimensionId Id() const;
+    PackedDimensionId PackedId() const;
     bool IsDerived() const;
 
     const Unit *GetBaseUnit() const;
     QList<const Unit*> Units() const;
+    UnitRange UnitsView() const;
+    int UnitCount() const;
+    quint32 Version() const;
 
     //==========================================================================
     /// Mutable interface.
     //==========================================================================
     Unit *GetBaseUnit();
     void SetBaseUnit( Unit *unit_p );
-    void AddUnit( Unit *unit_p );
     QList<Unit*> Units();
+    void Touch();
 
 private:
-    Dimension( const QString& name, const DimensionId& id );
+    Dimension( const QString& name, const DimensionId& id, 
+        const PackedDimensionId& packed_id );
+
+    // Units are only added to a dimension by the system that owns both.
+    void AddUnit( Unit *unit_p );
+    void Reserve( int unit_count );
 
+    friend class Unit;
     friend class UnitSystem;
 
-    /// The name of the dimension.
-    QString m_name;
+    /// The atom for the name of the dimension, as it was given.
+    Util::Atom m_name_atom;
 
     /// The unique identifier of the dimension.
     DimensionId m_id;
 
+    /// The identifier in terms of the system's base dimensions.
+    PackedDimensionId m_packed_id;
+
     /// The base unit.
     Unit *m_base_unit_p;
 
-    /// The list of all units in the dimension.
-    QList<Unit*> m_units;
+    /// The list of all units in the dimension, in the order they were added.
+    QVector<Unit*> m_units;
+
+    /// The number of times the dimension or its units have changed.
+    quint32 m_version;
 };
 
 } // namespace AutoUnits
@@ -10,19 +10,23 @@ TARGET = AutoUnits
 
 HEADERS += \
     ConversionParser.h \
+    ConversionPlan.h \
     Converter.h \
     DefinitionParser.h \
     DerivationParser.h \
     Dimension.h \
+    Reloader.h \
     Unit.h \
     UnitSystem.h \
 
 SOURCES += \
     ConversionParser.cpp \
+    ConversionPlan.cpp \
     Converter.cpp \
     DefinitionParser.cpp \
     DerivationParser.cpp \
     Dimension.cpp \
+    Reloader.cpp \
     Unit.cpp \
     UnitSystem.cpp \
 
@@ -0,0 +1,275 @@
+//==============================================================================
+/// \file AutoUnits/Reloader.cpp
+///
+/// Source file for the AutoUnits::Reloader class.
+///
+//==============================================================================
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include "Reloader.h"
+#include "UnitSystem.h"
+
+namespace AutoUnits
+{
+
+namespace
+{
+
+/// How long the definitions file must be left alone before it is reloaded,
+/// in milliseconds. Editors often save a file in several steps.
+const int RELOAD_DELAY_MS = 200;
+
+}
+
+//==============================================================================
+/// A thread that parses a definitions file.
+///
+class Reloader::ParseThread : public QThread
+{
+public:
+    //==========================================================================
+    /// Constructor.
+    ///
+    /// \param [in] path The definitions file.
+    ///
+    ParseThread( const QString& path ) :
+        m_path( path )
+    {
+    }
+
+    /// The parsed system, or NULL if parsing failed. Only valid once the
+    /// thread has finished.
+    std::auto_ptr<const UnitSystem> m_result_p;
+
+    /// The errors encountered while parsing. Only valid once the thread has
+    /// finished.
+    QList<ParseError> m_errors;
+
+protected:
+    //==========================================================================
+    /// Parse the file.
+    ///
+    virtual void run()
+    {
+        DefinitionParser parser( m_path );
+        m_errors = parser.Errors();
+        m_result_p = parser.TakeResult();
+    }
+
+private:
+    /// The definitions file.
+    QString m_path;
+};
+
+//==============================================================================
+/// Constructor.
+///
+/// \param [in] system_p The unit system.
+///
+Reloader::Generation::Generation( std::auto_ptr<const UnitSystem> system_p ) :
+    m_system_p( system_p )
+{
+}
+
+//==============================================================================
+/// Destructor.
+///
+Reloader::Generation::~Generation()
+{
+    qDeleteAll( m_converters );
+}
+
+//==============================================================================
+/// Get the unit system.
+///
+/// \return The unit system.
+///
+const UnitSystem *Reloader::Generation::System() const
+{
+    return m_system_p.get();
+}
+
+//==============================================================================
+/// Get the calling thread's converter for the unit system, creating it the
+/// first time the thread asks. The converter must only be used from the 
+/// calling thread, and lives as long as the generation.
+///
+/// \return The converter.
+///
+const Converter& Reloader::Generation::GetConverter() const
+{
+    QMutexLocker lock( &m_converters_mutex );
+
+    Converter *&converter_p = m_converters[QThread::currentThreadId()];
+    if ( !converter_p )
+    {
+        converter_p = new Converter( m_system_p.get() );
+    }
+    return *converter_p;
+}
+
+//==============================================================================
+/// Constructor. The definitions file is parsed before this returns, so the
+/// first generation is available immediately if the file is valid.
+///
+/// \param [in] path The definitions file.
+/// \param [in] parent_p The parent object.
+///
+Reloader::Reloader( const QString& path, QObject *parent_p ) :
+    QObject( parent_p ), m_path( path ), m_thread_p( NULL ),
+    m_pending( false )
+{
+    DefinitionParser parser( m_path );
+    std::auto_ptr<const UnitSystem> system_p( parser.TakeResult() );
+
+    if ( system_p.get() )
+    {
+        Publish( system_p, parser.Errors() );
+    }
+    else
+    {
+        m_errors = parser.Errors();
+    }
+
+    m_delay.setSingleShot( true );
+    m_delay.setInterval( RELOAD_DELAY_MS );
+
+    connect( &m_watcher, SIGNAL( fileChanged( const QString& ) ),
+        SLOT( OnFileChanged() ) );
+    connect( &m_delay, SIGNAL( timeout() ), SLOT( Reload() ) );
+
+    m_watcher.addPath( m_path );
+}
+
+//==============================================================================
+/// Destructor. This waits for a running parse to finish.
+///
+Reloader::~Reloader()
+{
+    if ( m_thread_p )
+    {
+        m_thread_p->wait();
+        delete m_thread_p;
+    }
+}
+
+//==============================================================================
+/// Get the current generation.
+///
+/// \return The generation, or a null handle if the definitions file has
+///         never been parsed successfully.
+///
+Reloader::Handle Reloader::Current() const
+{
+    QMutexLocker lock( &m_mutex );
+    return m_current;
+}
+
+//==============================================================================
+/// Get the errors and warnings from the last time the definitions file was
+/// parsed.
+///
+/// \return The errors.
+///
+QList<ParseError> Reloader::Errors() const
+{
+    QMutexLocker lock( &m_mutex );
+    return m_errors;
+}
+
+//==============================================================================
+/// Parse the definitions file on a background thread, and publish the result
+/// if parsing succeeds. If a parse is already running, the file is parsed
+/// again once it finishes.
+///
+void Reloader::Reload()
+{
+    if ( m_thread_p )
+    {
+        m_pending = true;
+        return;
+    }
+
+    m_thread_p = new ParseThread( m_path );
+    connect( m_thread_p, SIGNAL( finished() ), SLOT( OnParseFinished() ) );
+    m_thread_p->start();
+}
+
+//==============================================================================
+/// Schedule a reload once the definitions file stops changing.
+///
+void Reloader::OnFileChanged()
+{
+    // Editors that save by replacing the file remove it from the watcher.
+    if ( !m_watcher.files().contains( m_path ) )
+    {
+        m_watcher.addPath( m_path );
+    }
+
+    m_delay.start();
+}
+
+//==============================================================================
+/// Publish the result of a background parse.
+///
+void Reloader::OnParseFinished()
+{
+    m_thread_p->wait();
+    std::auto_ptr<const UnitSystem> system_p( m_thread_p->m_result_p );
+    QList<ParseError> errors( m_thread_p->m_errors );
+    delete m_thread_p;
+    m_thread_p = NULL;
+
+    if ( system_p.get() )
+    {
+        Publish( system_p, errors );
+        emit Reloaded();
+    }
+    else
+    {
+        {
+            QMutexLocker lock( &m_mutex );
+            m_errors = errors;
+        }
+        emit ReloadFailed();
+    }
+
+    if ( !m_watcher.files().contains( m_path ) )
+    {
+        m_watcher.addPath( m_path );
+    }
+
+    if ( m_pending )
+    {
+        m_pending = false;
+        Reload();
+    }
+}
+
+//==============================================================================
+/// Make a new generation current.
+///
+/// \param [in] system_p The unit system.
+/// \param [in] errors The warnings from parsing the system.
+///
+void Reloader::Publish( std::auto_ptr<const UnitSystem> system_p,
+    const QList<ParseError>& errors )
+{
+    // The generation is complete before readers can see it.
+    Handle next( new Generation( system_p ) );
+    Handle previous;
+
+    {
+        QMutexLocker lock( &m_mutex );
+        previous = m_current;
+        m_current = next;
+        m_errors = errors;
+    }
+
+    // If no readers hold the previous generation, it is destroyed here,
+    // outside the lock.
+}
+
+} // namespace AutoUnits
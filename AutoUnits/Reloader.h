@@ -0,0 +1,139 @@
+#ifndef AUTO_UNITS_RELOADER_H
+#define AUTO_UNITS_RELOADER_H
+//==============================================================================
+/// \file AutoUnits/Reloader.h
+///
+/// Header file for the AutoUnits::Reloader class.
+///
+//==============================================================================
+
+#include <memory>
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QTimer>
+
+#include "Converter.h"
+#include "DefinitionParser.h"
+
+namespace AutoUnits
+{
+
+class UnitSystem;
+
+//==============================================================================
+/// Keeps a unit system up to date with its definitions file. The file is
+/// watched for changes, and each change is parsed on a background thread.
+/// Once parsing succeeds, the new system and a converter for it are
+/// published together as a new generation, replacing the current one.
+///
+/// Readers take a handle to the current generation and use it for as long as
+/// they like. A reload never changes a published generation; it is released
+/// once the last handle to it is gone.
+///
+/// \note The reloader itself must be used from the thread that created it,
+///       since it relies on that thread's event loop. Current() may be called
+///       from any thread, and so may everything on a generation.
+///
+class Reloader : public QObject
+{
+    Q_OBJECT
+
+public:
+    //==========================================================================
+    /// A unit system and converters for it. A converter's caches aren't 
+    /// shared between threads, so each thread that asks for a converter gets
+    /// its own, all reading the one immutable system.
+    ///
+    class Generation
+    {
+    public:
+        Generation( std::auto_ptr<const UnitSystem> system_p );
+        ~Generation();
+
+        const UnitSystem *System() const;
+        const Converter& GetConverter() const;
+
+    private:
+        /// Not implemented.
+        Generation( const Generation& );
+        /// Not implemented.
+        Generation& operator=( const Generation& );
+
+        /// The unit system. This must outlive the converters.
+        std::auto_ptr<const UnitSystem> m_system_p;
+
+        /// Maps thread -> the thread's converter. This owns the converters.
+        mutable QHash<Qt::HANDLE, Converter*> m_converters;
+
+        /// Guards m_converters.
+        mutable QMutex m_converters_mutex;
+    };
+
+    /// A reference to a generation.
+    typedef QSharedPointer<const Generation> Handle;
+
+    Reloader( const QString& path, QObject *parent_p = NULL );
+    ~Reloader();
+
+    Handle Current() const;
+    QList<ParseError> Errors() const;
+
+public slots:
+    void Reload();
+
+signals:
+    //==========================================================================
+    /// Emitted when a new generation is published.
+    ///
+    void Reloaded();
+
+    //==========================================================================
+    /// Emitted when the definitions file changed but couldn't be parsed. The
+    /// current generation is kept.
+    ///
+    void ReloadFailed();
+
+private slots:
+    void OnFileChanged();
+    void OnParseFinished();
+
+private:
+    class ParseThread;
+
+    void Publish( std::auto_ptr<const UnitSystem> system_p,
+        const QList<ParseError>& errors );
+
+    /// The definitions file.
+    QString m_path;
+
+    /// Watches the definitions file.
+    QFileSystemWatcher m_watcher;
+
+    /// Delays reloading until the file has stopped changing.
+    QTimer m_delay;
+
+    /// The thread parsing the file, if a parse is running.
+    ParseThread *m_thread_p;
+
+    /// Whether the file changed again while it was being parsed.
+    bool m_pending;
+
+    /// The current generation.
+    Handle m_current;
+
+    /// The errors from the last parse.
+    QList<ParseError> m_errors;
+
+    /// Guards m_current and m_errors.
+    mutable QMutex m_mutex;
+};
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_RELOADER_H
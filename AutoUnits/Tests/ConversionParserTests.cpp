@@ -353,6 +353,34 @@ private slots:
         QVERIFY( Compare( composed0_p, expect_p ) );
         QVERIFY( Compare( composed1_p, expect_p ) );
     }
+
+    void Affine()
+    {
+        ConversionPtr conv_p( 
+            ParseConversion( "(value + 459.67) * 5.0 / 9.0" ) );
+        double scale = 0.0;
+        double offset = 0.0;
+
+        QVERIFY( GetAffine( *conv_p, &scale, &offset ) );
+        QVERIFY( Compare( scale, 5.0 / 9.0 ) );
+        QVERIFY( Compare( offset, 459.67 * 5.0 / 9.0 ) );
+
+        conv_p = ParseConversion( "3.0 - value / 2.0" );
+        QVERIFY( GetAffine( *conv_p, &scale, &offset ) );
+        QVERIFY( Compare( scale, -0.5 ) );
+        QVERIFY( Compare( offset, 3.0 ) );
+    }
+
+    void NotAffine()
+    {
+        double scale = 0.0;
+        double offset = 0.0;
+
+        QVERIFY( !GetAffine( *ParseConversion( "value * value" ), 
+            &scale, &offset ) );
+        QVERIFY( !GetAffine( *ParseConversion( "1.0 / (value + 1.0)" ), 
+            &scale, &offset ) );
+    }
 };
 
 #include "ConversionParserTests.moc"
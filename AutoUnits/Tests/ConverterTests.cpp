@@ -0,0 +1,994 @@
+#include <QtTest/QtTest>
+#include <cmath>
+#include <cstddef>
+
+#include "Test.h"
+
+#include "ConversionParser.h"
+#include "ConversionPlan.h"
+#include "Converter.h"
+#include "Dimension.h"
+#include "Types/Conversion.h"
+#include "Unit.h"
+#include "UnitSystem.h"
+#include "Util/ConversionStream.h"
+
+using namespace AutoUnits;
+
+//==============================================================================
+/// A thread that repeatedly looks up the products and quotients of every pair
+/// of dimensions in a system, and counts the wrong results.
+/// 
+class AlgebraReader : public QThread
+{
+public:
+    typedef QPair<const Dimension*, const Dimension*> Operands;
+    typedef QHash<Operands, QPair<const Dimension*, const Dimension*> > 
+        Results;
+
+    AlgebraReader( const UnitSystem *system_p, const Results& expected ) : 
+        m_system_p( system_p ), m_expected( expected ), m_failures( 0 )
+    {
+    }
+
+    int Failures() const
+    {
+        return m_failures;
+    }
+
+protected:
+    virtual void run()
+    {
+        for ( int i = 0; i < 2000; ++i )
+        {
+            for ( Results::const_iterator it = m_expected.begin(); 
+                it != m_expected.end(); ++it )
+            {
+                const Dimension *lhs_p = it.key().first;
+                const Dimension *rhs_p = it.key().second;
+                if ( ( m_system_p->Multiply( lhs_p, rhs_p ) != 
+                        it.value().first ) ||
+                    ( m_system_p->Divide( lhs_p, rhs_p ) != 
+                        it.value().second ) )
+                {
+                    ++m_failures;
+                }
+            }
+        }
+    }
+
+private:
+    const UnitSystem *m_system_p;
+    Results m_expected;
+    int m_failures;
+};
+
+class ConverterTests : public QObject
+{
+    Q_OBJECT;
+
+private:
+    bool Compare( double l, double r )
+    {
+        return std::abs( l - r ) < ( 1.0e-10 );
+    }
+
+    Unit *AddUnit( UnitSystem *system_p, const QString& name,
+        const Dimension *dim_p, const QString& to_base, 
+        const QString& from_base )
+    {
+        Unit *unit_p = system_p->NewUnit( name, dim_p );
+        unit_p->SetToBase( ParseConversion( to_base ) );
+        unit_p->SetFromBase( ParseConversion( from_base ) );
+        return unit_p;
+    }
+
+    std::auto_ptr<UnitSystem> CreateSystem()
+    {
+        std::auto_ptr<UnitSystem> system_p( UnitSystem::Create() );
+
+        Dimension *length_p =
+            system_p->NewDimension( "Length", DimensionId( "Meter" ) );
+        length_p->SetBaseUnit( system_p->NewUnit( "Meter", length_p ) );
+        AddUnit( system_p.get(), "Foot", length_p,
+            "value * 0.3048", "value / 0.3048" );
+        AddUnit( system_p.get(), "Mile", length_p,
+            "value * 1609.344", "value / 1609.344" );
+
+        Dimension *temp_p =
+            system_p->NewDimension( "Temperature", DimensionId( "Kelvin" ) );
+        temp_p->SetBaseUnit( system_p->NewUnit( "Kelvin", temp_p ) );
+        AddUnit( system_p.get(), "Fahrenheit", temp_p,
+            "(value + 459.67) * 5.0 / 9.0", "value * 9.0 / 5.0 - 459.67" );
+
+        Dimension *time_p =
+            system_p->NewDimension( "Time", DimensionId( "Second" ) );
+        time_p->SetBaseUnit( system_p->NewUnit( "Second", time_p ) );
+        AddUnit( system_p.get(), "Hour", time_p, 
+            "value * 3600", "value / 3600" );
+
+        Dimension *speed_p = system_p->NewDimension( "Speed", 
+            DimensionId( "Meter" ) / DimensionId( "Second" ) );
+        speed_p->SetBaseUnit( system_p->NewUnit( "MeterPerSecond", speed_p ) );
+
+        system_p->SetSymbol( system_p->GetUnit( "Meter" ), "m" );
+        system_p->SetSymbol( system_p->GetUnit( "Foot" ), "ft" );
+        system_p->SetSymbol( system_p->GetUnit( "Mile" ), "mi" );
+        system_p->SetSymbol( system_p->GetUnit( "Second" ), "s" );
+        system_p->SetSymbol( system_p->GetUnit( "Hour" ), "h" );
+        system_p->SetSymbol( system_p->GetUnit( "Fahrenheit" ), "degF" );
+
+        return system_p;
+    }
+
+    QString CachePath()
+    {
+        return QDir::tempPath() + "/AutoUnitsConverterTests.cache";
+    }
+
+private slots:
+    void Convert()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QVERIFY( converter.CanConvert( "Foot", "Meter" ) );
+        QVERIFY( !converter.CanConvert( "Foot", "Kelvin" ) );
+        QVERIFY( Compare( converter.Convert( "Mile", "Foot", 1.0 ), 5280.0 ) );
+        QVERIFY( Compare(
+            converter.Convert( "Fahrenheit", "Kelvin", 32.0 ), 273.15 ) );
+    }
+
+    void PackedDimensionId()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+
+        const Dimension *length_p = system_p->GetDimension( "Length" );
+        const Dimension *time_p = system_p->GetDimension( "Time" );
+        const Dimension *speed_p = system_p->GetDimension( "Speed" );
+
+        QVERIFY( speed_p->PackedId() == 
+            length_p->PackedId() / time_p->PackedId() );
+        QVERIFY( length_p->PackedId() != time_p->PackedId() );
+        QVERIFY( ( length_p->PackedId() / length_p->PackedId() ).IsScalar() );
+        QCOMPARE( system_p->GetDimension( 
+            speed_p->PackedId() * time_p->PackedId() ), length_p );
+        QCOMPARE( system_p->GetDimension( length_p->PackedId() ^ 2 ), 
+            static_cast<const Dimension*>( NULL ) );
+        QVERIFY( system_p->Unpack( speed_p->PackedId() ) == speed_p->Id() );
+    }
+
+    void ConcurrentAlgebra()
+    {
+        std::auto_ptr<UnitSystem> system_p( CreateSystem() );
+        system_p->Freeze();
+        const UnitSystem *const_system_p = system_p.get();
+
+        AlgebraReader::Results expected;
+        UnitSystem::DimensionRange dims( const_system_p->DimensionsView() );
+        for ( int i = 0; i < dims.count(); ++i )
+        {
+            for ( int j = 0; j < dims.count(); ++j )
+            {
+                expected.insert( qMakePair( dims[i], dims[j] ), qMakePair( 
+                    const_system_p->GetDimension( 
+                        dims[i]->PackedId() * dims[j]->PackedId() ),
+                    const_system_p->GetDimension( 
+                        dims[i]->PackedId() / dims[j]->PackedId() ) ) );
+            }
+        }
+
+        QList<AlgebraReader*> readers;
+        for ( int i = 0; i < 4; ++i )
+        {
+            readers.append( new AlgebraReader( const_system_p, expected ) );
+        }
+        for ( int i = 0; i < readers.count(); ++i )
+        {
+            readers[i]->start();
+        }
+
+        int failures = 0;
+        for ( int i = 0; i < readers.count(); ++i )
+        {
+            readers[i]->wait();
+            failures += readers[i]->Failures();
+        }
+        qDeleteAll( readers );
+
+        QCOMPARE( failures, 0 );
+    }
+
+    void TooManyBaseDimensions()
+    {
+        std::auto_ptr<UnitSystem> system_p( CreateSystem() );
+
+        // The test system has three base dimensions.
+        for ( int i = 3; i < AutoUnits::PackedDimensionId::MAX_BASES; ++i )
+        {
+            QString name( QString( "Base%1" ).arg( i ) );
+            QVERIFY( system_p->NewDimension( name, DimensionId( name ) ) );
+        }
+
+        DimensionId id( DimensionId( "Extra1" ) * DimensionId( "Extra2" ) );
+        quint32 version = system_p->Version();
+        QVERIFY( !system_p->NewDimension( "Extra", id ) );
+        QVERIFY( !system_p->GetDimension( "Extra" ) );
+        QCOMPARE( system_p->Version(), version );
+
+        // A dimension derived from existing bases still fits.
+        QVERIFY( system_p->NewDimension( "Area", 
+            DimensionId( "Meter" ) * DimensionId( "Meter" ) ) );
+    }
+
+    void DimensionAlgebra()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+
+        const Dimension *length_p = system_p->GetDimension( "Length" );
+        const Dimension *time_p = system_p->GetDimension( "Time" );
+        const Dimension *speed_p = system_p->GetDimension( "Speed" );
+        const Dimension *scalar_p = system_p->GetDimension( "Scalar" );
+
+        for ( int i = 0; i < 2; ++i )
+        {
+            QCOMPARE( system_p->Divide( length_p, time_p ), speed_p );
+            QCOMPARE( system_p->Multiply( speed_p, time_p ), length_p );
+            QCOMPARE( system_p->Multiply( time_p, speed_p ), length_p );
+            QCOMPARE( system_p->Divide( length_p, length_p ), scalar_p );
+            QCOMPARE( system_p->Multiply( length_p, length_p ), 
+                static_cast<const Dimension*>( NULL ) );
+        }
+    }
+
+    void Freeze()
+    {
+        std::auto_ptr<UnitSystem> frozen_p( CreateSystem() );
+        QByteArray fingerprint( frozen_p->Fingerprint() );
+        frozen_p->Freeze();
+
+        std::auto_ptr<const UnitSystem> system_p( frozen_p.release() );
+        Converter converter( system_p.get() );
+
+        QCOMPARE( system_p->Fingerprint(), fingerprint );
+        QCOMPARE( system_p->Units().count(), 9 );
+
+        const Dimension *length_p = system_p->GetDimension( "length" );
+        QVERIFY( length_p );
+        QCOMPARE( length_p->Name(), QString( "Length" ) );
+        QCOMPARE( length_p->GetBaseUnit(), system_p->GetUnit( "Meter" ) );
+        QCOMPARE( system_p->GetDimension( length_p->Id() ), length_p );
+        QCOMPARE( system_p->GetUnitBySymbol( "ft" ), 
+            system_p->GetUnit( "Foot" ) );
+
+        QList<const Unit*> units( length_p->Units() );
+        for ( int i = 0; i < units.count(); ++i )
+        {
+            QCOMPARE( units[i]->GetDimension(), length_p );
+            QCOMPARE( units[i]->Index(), i );
+            QCOMPARE( units[i], units[0] + i );
+        }
+
+        QVERIFY( Compare( converter.Convert( "mi", "Foot", 1.0 ), 5280.0 ) );
+        QVERIFY( Compare( 
+            converter.Convert( "Kilometer / Hour", "MeterPerSecond", 3.6 ), 
+            1.0 ) );
+    }
+
+    void Views()
+    {
+        std::auto_ptr<UnitSystem> system_p( CreateSystem() );
+        const UnitSystem *const_system_p = system_p.get();
+
+        UnitSystem::UnitRange units( const_system_p->UnitsView() );
+        QCOMPARE( units.count(), 9 );
+        QCOMPARE( units[0]->Name(), QString( "Scalar" ) );
+        QCOMPARE( units[1]->Name(), QString( "Meter" ) );
+        QCOMPARE( units[units.count() - 1]->Name(),
+            QString( "MeterPerSecond" ) );
+
+        system_p->Freeze();
+
+        // Frozen dimensions are sorted by name, and their units follow the
+        // same order.
+        UnitSystem::DimensionRange dims( const_system_p->DimensionsView() );
+        QCOMPARE( dims.count(), 5 );
+        units = const_system_p->UnitsView();
+        int index = 0;
+        for ( UnitSystem::DimensionRange::const_iterator it = dims.begin();
+            it != dims.end(); ++it )
+        {
+            QVERIFY( ( it == dims.begin() ) ||
+                ( ( *( it - 1 ) )->Name() < ( *it )->Name() ) );
+
+            Dimension::UnitRange dim_units( ( *it )->UnitsView() );
+            for ( int i = 0; i < dim_units.count(); ++i )
+            {
+                QCOMPARE( units[index++], dim_units[i] );
+            }
+        }
+        QCOMPARE( index, units.count() );
+    }
+
+    void Atoms()
+    {
+        std::auto_ptr<UnitSystem> first_p( CreateSystem() );
+        std::auto_ptr<UnitSystem> second_p( CreateSystem() );
+
+        Util::Atom foot = first_p->GetUnit( "Foot" )->NameAtom();
+        QVERIFY( foot != 0 );
+        QCOMPARE( Util::AtomTable::Text( foot ), QString( "FOOT" ) );
+        QCOMPARE( Util::AtomTable::Find( "FOOT" ), foot );
+        QVERIFY( foot != first_p->GetUnit( "Mile" )->NameAtom() );
+        QCOMPARE( second_p->GetUnit( "foot" )->NameAtom(), foot );
+
+        // Names are kept as given, and share the normalized atom.
+        Util::Atom exact = Util::AtomTable::Find( "Foot" );
+        QVERIFY( exact != 0 );
+        QVERIFY( exact != foot );
+        QCOMPARE( Util::AtomTable::Normalized( exact ), foot );
+        QCOMPARE( Util::AtomTable::Normalized( foot ), foot );
+        QCOMPARE( first_p->GetUnit( "FOOT" )->Name(), QString( "Foot" ) );
+        QCOMPARE( Util::AtomTable::Find( "No such name" ), Util::Atom( 0 ) );
+
+        // Atoms are kept when the system is compacted.
+        second_p->Freeze();
+        QCOMPARE( second_p->GetUnit( " FOOT " )->NameAtom(), foot );
+        QCOMPARE( second_p->GetDimension( "Length" )->NameAtom(),
+            first_p->GetDimension( "length" )->NameAtom() );
+    }
+
+    void Arena()
+    {
+        Util::Arena arena;
+        char *first_p = static_cast<char*>( arena.Allocate( 3 ) );
+        char *second_p = static_cast<char*>( arena.Allocate( 1 ) );
+        QCOMPARE( std::size_t( first_p ) % 16, std::size_t( 0 ) );
+        QCOMPARE( second_p, first_p + 16 );
+
+        // Allocations larger than a chunk get one of their own.
+        char *large_p = static_cast<char*>( arena.Allocate( 1 << 20 ) );
+        large_p[( 1 << 20 ) - 1] = 0;
+        QCOMPARE( std::size_t( large_p ) % 16, std::size_t( 0 ) );
+
+        // Reserved allocations come from one stretch of memory.
+        arena.Reserve( 24, 1000 );
+        char *begin_p = static_cast<char*>( arena.Allocate( 24 ) );
+        for ( int i = 1; i < 1000; ++i )
+        {
+            QCOMPARE( static_cast<char*>( arena.Allocate( 24 ) ),
+                begin_p + 32 * i );
+        }
+
+        // So are several kinds of allocation reserved at once.
+        QCOMPARE( Util::Arena::Aligned( 24 ), std::size_t( 32 ) );
+        QCOMPARE( Util::Arena::Aligned( 32 ), std::size_t( 32 ) );
+        arena.Reserve( 
+            Util::Arena::Aligned( 8 ) * 1000 + Util::Arena::Aligned( 40 ) );
+        begin_p = static_cast<char*>( arena.Allocate( 40 ) );
+        for ( int i = 0; i < 1000; ++i )
+        {
+            QCOMPARE( static_cast<char*>( arena.Allocate( 8 ) ),
+                begin_p + 48 + 16 * i );
+        }
+    }
+
+    void ConvertToMany()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        const double values[] = { 0.0, 1.0, 2.5 };
+        double meters[3];
+        double feet[3];
+        double *results[] = { meters, feet };
+
+        QVERIFY( converter.ConvertToMany( "Mile", 
+            QStringList() << "Meter" << "Foot", values, 3, results ) );
+
+        for ( int i = 0; i < 3; ++i )
+        {
+            QVERIFY( Compare( meters[i], 
+                converter.Convert( "Mile", "Meter", values[i] ) ) );
+            QVERIFY( Compare( feet[i], 
+                converter.Convert( "Mile", "Foot", values[i] ) ) );
+        }
+
+        // Symbols and expressions resolve as they do for Convert().
+        double speeds[3];
+        double *speed_results[] = { speeds };
+        QVERIFY( converter.ConvertToMany( "mi / h", 
+            QStringList() << "m / s", values, 3, speed_results ) );
+        QVERIFY( Compare( speeds[2], 
+            converter.Convert( "mi / h", "m / s", values[2] ) ) );
+
+        // Unknown units and mismatched dimensions are reported, and nothing
+        // is written.
+        meters[0] = -1.0;
+        QVERIFY( !converter.ConvertToMany( "Mile", 
+            QStringList() << "Meter" << "Furlong", values, 3, results ) );
+        QVERIFY( !converter.ConvertToMany( "Mile", 
+            QStringList() << "Meter" << "Kelvin", values, 3, results ) );
+        QVERIFY( !converter.ConvertToMany( "Furlong", 
+            QStringList() << "Meter", values, 3, results ) );
+        QCOMPARE( meters[0], -1.0 );
+    }
+
+    void ConvertFromMany()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        const Unit *units[] = { 
+            system_p->GetUnit( "Foot" ), 
+            system_p->GetUnit( "Meter" ),
+            system_p->GetUnit( "Mile" ),
+            system_p->GetUnit( "Foot" ),
+        };
+        const double values[] = { 3.0, 1.0, 0.5, 0.0 };
+        double results[4];
+
+        converter.ConvertFromMany( units, "Foot", values, 4, results );
+
+        for ( int i = 0; i < 4; ++i )
+        {
+            QVERIFY( Compare( results[i], converter.Convert( 
+                units[i]->Name(), "Foot", values[i] ) ) );
+        }
+
+        // Prefixed units get table slots, and units of another dimension 
+        // give NaN.
+        const Unit *kilometer_p = system_p->GetUnit( "Kilometer" );
+        QVERIFY( kilometer_p );
+        QCOMPARE( kilometer_p->Index(), -1 );
+        const Unit *mixed[] = { 
+            kilometer_p, kilometer_p, system_p->GetUnit( "Kelvin" ), 
+            system_p->GetUnit( "Millimeter" ), kilometer_p 
+        };
+        const double mixed_values[] = { 1.0, 2.0, 3.0, 1000.0, 0.5 };
+        double mixed_results[5];
+        converter.ConvertFromMany( 
+            mixed, "Meter", mixed_values, 5, mixed_results );
+
+        QVERIFY( Compare( mixed_results[0], 1000.0 ) );
+        QVERIFY( Compare( mixed_results[1], 2000.0 ) );
+        QVERIFY( mixed_results[2] != mixed_results[2] );
+        QVERIFY( Compare( mixed_results[3], 1.0 ) );
+        QVERIFY( Compare( mixed_results[4], 500.0 ) );
+
+        converter.ConvertFromMany( 
+            mixed, "Furlong", mixed_values, 5, mixed_results );
+        QVERIFY( mixed_results[0] != mixed_results[0] );
+    }
+
+    void ConvertFromColumn()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QStringList names;
+        names << "Foot" << "Foot" << "mile" << "Foot" << "Furlong" << "Mile";
+
+        QVector<const Unit*> units( system_p->GetUnits( names ) );
+        QCOMPARE( units.count(), names.count() );
+        QCOMPARE( units[0], system_p->GetUnit( "Foot" ) );
+        QCOMPARE( units[1], units[0] );
+        QCOMPARE( units[2], system_p->GetUnit( "Mile" ) );
+        QCOMPARE( units[3], units[0] );
+        QVERIFY( !units[4] );
+        QCOMPARE( units[5], units[2] );
+
+        units.remove( 4 );
+        const double values[] = { 1.0, 2.0, 1.0, 3.0, 2.0 };
+        double results[5];
+        converter.ConvertFromMany( 
+            units.constData(), "Foot", values, units.count(), results );
+
+        QVERIFY( Compare( results[1], 2.0 ) );
+        QVERIFY( Compare( results[2], 5280.0 ) );
+        QVERIFY( Compare( results[4], 10560.0 ) );
+    }
+
+    void ConvertArray()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        const double values[] = { -40.0, 32.0, 212.0 };
+        double results[3];
+
+        converter.Convert( "Fahrenheit", "Kelvin", values, 3, results );
+
+        QVERIFY( Compare( results[0], 233.15 ) );
+        QVERIFY( Compare( results[1], 273.15 ) );
+        QVERIFY( Compare( results[2], 373.15 ) );
+    }
+
+    void ConvertMixed()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        const Unit *foot_p = system_p->GetUnit( "Foot" );
+        const Unit *meter_p = system_p->GetUnit( "Meter" );
+        const Unit *mile_p = system_p->GetUnit( "Mile" );
+        const Unit *kelvin_p = system_p->GetUnit( "Kelvin" );
+        const Unit *fahrenheit_p = system_p->GetUnit( "Fahrenheit" );
+
+        const Unit *from[] = { 
+            foot_p, fahrenheit_p, foot_p, foot_p, mile_p, kelvin_p };
+        const Unit *to[] = { 
+            meter_p, kelvin_p, meter_p, mile_p, foot_p, fahrenheit_p };
+        const double values[] = { 1.0, 32.0, 2.0, 5280.0, 0.5, 0.0 };
+        double results[6];
+
+        converter.ConvertMixed( from, to, values, 6, results );
+
+        for ( int i = 0; i < 6; ++i )
+        {
+            QVERIFY( Compare( results[i], converter.Convert( 
+                from[i]->Name(), to[i]->Name(), values[i] ) ) );
+        }
+
+        // A pair of units with different dimensions gives NaN for its own 
+        // values only.
+        const Unit *bad_from[] = { foot_p, foot_p, mile_p, foot_p };
+        const Unit *bad_to[] = { kelvin_p, meter_p, kelvin_p, kelvin_p };
+        const double bad_values[] = { 1.0, 2.0, 3.0, 4.0 };
+        double bad_results[4];
+
+        converter.ConvertMixed( bad_from, bad_to, bad_values, 4, bad_results );
+
+        QVERIFY( bad_results[0] != bad_results[0] );
+        QVERIFY( Compare( bad_results[1], 0.6096 ) );
+        QVERIFY( bad_results[2] != bad_results[2] );
+        QVERIFY( bad_results[3] != bad_results[3] );
+    }
+
+    void ConvertExpression()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QVERIFY( converter.CanConvert( "Mile / Hour", "MeterPerSecond" ) );
+        QVERIFY( Compare( 
+            converter.Convert( "Mile / Hour", "MeterPerSecond", 1.0 ), 
+            0.44704 ) );
+        QVERIFY( Compare( 
+            converter.Convert( "Meter / Second", "Foot/Hour", 1.0 ), 
+            3600.0 / 0.3048 ) );
+        QVERIFY( Compare( converter.Convert( "Foot / Mile", "Scalar", 1.0 ), 
+            0.3048 / 1609.344 ) );
+
+        QVERIFY( !converter.CanConvert( "Mile * Hour", "MeterPerSecond" ) );
+        QVERIFY( !converter.CanConvert( "Fahrenheit / Hour", "Kelvin" ) );
+        QVERIFY( !converter.CanConvert( "Furlong / Hour", "MeterPerSecond" ) );
+        QVERIFY( !converter.CanConvert( "Mile / ", "MeterPerSecond" ) );
+        QVERIFY( !converter.GetConversion( "Mile / ", "MeterPerSecond" ) );
+    }
+
+    void ConvertManyExpressions()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        // More distinct expressions than the converter keeps parsed, so the
+        // cache is emptied along the way.
+        QString text( "Mile / Hour" );
+        for ( int i = 0; i < 600; ++i )
+        {
+            text += " * 1";
+            QVERIFY( Compare( 
+                converter.Convert( text, "MeterPerSecond", 1.0 ), 0.44704 ) );
+            QVERIFY( Compare( 
+                converter.Convert( "MeterPerSecond", text, 0.44704 ), 1.0 ) );
+            QVERIFY( !converter.CanConvert( text + " * Furlong", "Meter" ) );
+        }
+
+        QVERIFY( Compare( 
+            converter.Convert( "Mile / Hour", "MeterPerSecond", 2.0 ), 
+            0.89408 ) );
+    }
+
+    void ConvertPrefixed()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        const Unit *km_p = system_p->GetUnit( "kilometer" );
+        QVERIFY( km_p );
+        QCOMPARE( km_p->Name(), QString( "Kilometer" ) );
+        QCOMPARE( km_p, system_p->GetUnit( "Kilometer" ) );
+        QCOMPARE( km_p->GetDimension(), system_p->GetDimension( "Length" ) );
+        QVERIFY( !system_p->Units().contains( km_p ) );
+        QVERIFY( !system_p->GetUnit( "Kilofurlong" ) );
+
+        QVERIFY( Compare( converter.Convert( "Kilometer", "Meter", 1.0 ), 
+            1000.0 ) );
+        QVERIFY( Compare( converter.Convert( "Millikelvin", "Kelvin", 1.0 ), 
+            0.001 ) );
+        QVERIFY( Compare( 
+            converter.Convert( "Kilometer / Hour", "MeterPerSecond", 3.6 ), 
+            1.0 ) );
+
+        const Unit *units[] = { km_p, system_p->GetUnit( "Meter" ) };
+        const double values[] = { 2.0, 3.0 };
+        double results[2];
+        converter.ConvertFromMany( units, "Meter", values, 2, results );
+        QVERIFY( Compare( results[0], 2000.0 ) );
+        QVERIFY( Compare( results[1], 3.0 ) );
+    }
+
+    void ConvertSymbol()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QCOMPARE( system_p->GetUnitBySymbol( "ft" ), 
+            system_p->GetUnit( "Foot" ) );
+        QCOMPARE( system_p->GetUnitBySymbol( "mi" ), 
+            system_p->GetUnit( "Mile" ) );
+        QCOMPARE( system_p->GetUnitBySymbol( "km" ), 
+            system_p->GetUnit( "Kilometer" ) );
+        QCOMPARE( system_p->GetUnitBySymbol( "dam" ), 
+            system_p->GetUnit( "Decameter" ) );
+        QCOMPARE( system_p->GetUnitBySymbol( "ms" ), 
+            system_p->GetUnit( "Millisecond" ) );
+        QCOMPARE( system_p->GetUnit( "Kilometer" )->Symbol(), QString( "km" ) );
+        QVERIFY( !system_p->GetUnitBySymbol( "Ft" ) );
+        QVERIFY( !system_p->GetUnitBySymbol( "k" ) );
+        QVERIFY( !system_p->GetUnitBySymbol( "" ) );
+
+        QVERIFY( Compare( converter.Convert( "mi", "ft", 1.0 ), 5280.0 ) );
+        QVERIFY( Compare( 
+            converter.Convert( "degF", "Kelvin", 32.0 ), 273.15 ) );
+        QVERIFY( Compare( 
+            converter.Convert( "km / h", "m/s", 3.6 ), 1.0 ) );
+    }
+
+    void BestUnit()
+    {
+        std::auto_ptr<UnitSystem> metric_p( UnitSystem::Create() );
+        Dimension *length_p = 
+            metric_p->NewDimension( "Length", DimensionId( "Meter" ) );
+        length_p->SetBaseUnit( metric_p->NewUnit( "Meter", length_p ) );
+        AddUnit( metric_p.get(), "Millimeter", length_p, 
+            "value / 1000", "value * 1000" );
+        AddUnit( metric_p.get(), "Kilometer", length_p, 
+            "value * 1000", "value / 1000" );
+        metric_p->Freeze();
+
+        const UnitSystem *const_metric_p = metric_p.get();
+        Converter metric( const_metric_p );
+        const Unit *mm_p = const_metric_p->GetUnit( "Millimeter" );
+        const Unit *m_p = const_metric_p->GetUnit( "Meter" );
+        const Unit *km_p = const_metric_p->GetUnit( "Kilometer" );
+
+        QVERIFY( metric.BestUnit( "Meter", 0.0003 ) == mm_p );
+        QVERIFY( metric.BestUnit( "Meter", 5.0e6 ) == km_p );
+        QVERIFY( metric.BestUnit( "Meter", -5.0e6 ) == km_p );
+        QVERIFY( metric.BestUnit( "Meter", 1.0 ) == m_p );
+        QVERIFY( metric.BestUnit( "Meter", 0.5 ) == mm_p );
+        QVERIFY( metric.BestUnit( "Kilometer", 0.0025 ) == m_p );
+
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QVERIFY( converter.BestUnit( "Foot", 5280.0 ) ==
+            system_p->GetUnit( "Mile" ) );
+        QVERIFY( converter.BestUnit( "km", 0.0009144 ) ==
+            system_p->GetUnit( "Foot" ) );
+        QVERIFY( !converter.BestUnit( "Fahrenheit", 100.0 ) );
+
+        const double values[] = { 0.002, 5000.0, 0.003 };
+        QVERIFY( converter.BestUnit( "Meter", values, 3 ) ==
+            system_p->GetUnit( "Foot" ) );
+        QVERIFY( converter.BestUnit(
+            "Meter", values, 3, Converter::Maximum ) ==
+                system_p->GetUnit( "Mile" ) );
+    }
+
+    void Aliases()
+    {
+        std::auto_ptr<UnitSystem> system_p( CreateSystem() );
+        QVERIFY( system_p->AddAlias( "Feet", system_p->GetUnit( "Foot" ) ) );
+        QVERIFY( system_p->AddAlias( "Distance", 
+            system_p->GetDimension( "Length" ) ) );
+        QVERIFY( !system_p->AddAlias( "Mile", system_p->GetUnit( "Foot" ) ) );
+        system_p->Freeze();
+
+        const UnitSystem *const_system_p = system_p.get();
+        QVERIFY( const_system_p->GetUnit( "feet" ) == 
+            const_system_p->GetUnit( "Foot" ) );
+        QVERIFY( const_system_p->GetDimension( "Distance" ) == 
+            const_system_p->GetDimension( "Length" ) );
+        QCOMPARE( const_system_p->Units().count(), 9 );
+
+        Converter converter( const_system_p );
+        const Conversion *conv_p = converter.GetConversion( "Foot", "Mile" );
+        QVERIFY( conv_p );
+        QVERIFY( converter.GetConversion( "Feet", "Mile" ) == conv_p );
+        QVERIFY( converter.GetConversion( "ft", "mi" ) == conv_p );
+        QVERIFY( Compare( converter.Convert( "Feet", "Mile", 5280.0 ), 1.0 ) );
+    }
+
+    void ConversionPlan()
+    {
+        struct Record
+        {
+            double altitude;
+            float temperature;
+            int id;
+        };
+
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QList<AutoUnits::ConversionPlan::Field> fields;
+        fields << AutoUnits::ConversionPlan::Field(
+            offsetof( Record, altitude ), AutoUnits::ConversionPlan::Double,
+            "Foot", "Meter" );
+        fields << AutoUnits::ConversionPlan::Field( 
+            offsetof( Record, temperature ), AutoUnits::ConversionPlan::Float, 
+            "Fahrenheit", "Kelvin" );
+
+        AutoUnits::ConversionPlan plan( converter, sizeof( Record ), fields );
+
+        Record records[] = { { 1000.0, 32.0f, 7 }, { 0.0, 212.0f, 8 } };
+        plan.Apply( records, 2 );
+
+        QVERIFY( Compare( records[0].altitude, 304.8 ) );
+        QVERIFY( std::abs( records[0].temperature - 273.15f ) < 1.0e-3f );
+        QCOMPARE( records[0].id, 7 );
+        QVERIFY( Compare( records[1].altitude, 0.0 ) );
+        QVERIFY( std::abs( records[1].temperature - 373.15f ) < 1.0e-3f );
+        QCOMPARE( records[1].id, 8 );
+    }
+
+    void IncrementalUpdate()
+    {
+        std::auto_ptr<UnitSystem> system_p( CreateSystem() );
+        system_p->Freeze();
+
+        const UnitSystem *const_system_p = system_p.get();
+        Converter converter( const_system_p );
+
+        QVERIFY( Compare( converter.Convert( "Mile", "Meter", 1.0 ), 
+            1609.344 ) );
+        QVERIFY( Compare( converter.Convert( "mi / h", "m / s", 3600.0 ), 
+            1609.344 ) );
+        const Conversion *hours_p = 
+            converter.GetConversion( "Hour", "Second" );
+        const Unit *kilomile_p = const_system_p->GetUnit( "Kilomile" );
+        const Conversion *mile_to_base_p = 
+            const_system_p->GetUnit( "Mile" )->ToBase();
+
+        system_p->GetUnit( "Mile" )->SetToBase( 
+            ParseConversion( "value * 1609.3" ) );
+        system_p->GetUnit( "Mile" )->SetFromBase( 
+            ParseConversion( "value / 1609.3" ) );
+        QVERIFY( Compare( converter.Convert( "Mile", "Meter", 1.0 ), 
+            1609.3 ) );
+        QVERIFY( Compare( converter.Convert( "mi / h", "m / s", 3600.0 ), 
+            1609.3 ) );
+        QVERIFY( Compare( converter.Convert( "Kilomile", "Meter", 1.0 ), 
+            1609300.0 ) );
+
+        // Prefixed units already handed out keep their old definition.
+        QVERIFY( const_system_p->GetUnit( "Kilomile" ) != kilomile_p );
+        QVERIFY( Compare( kilomile_p->ToBase()->Eval( 1.0 ), 1609344.0 ) );
+
+        // So do replaced conversions, which stay in the system's arena.
+        QVERIFY( const_system_p->GetUnit( "Mile" )->ToBase() != 
+            mile_to_base_p );
+        QVERIFY( Compare( mile_to_base_p->Eval( 1.0 ), 1609.344 ) );
+
+        AddUnit( system_p.get(), "Yard", system_p->GetDimension( "Length" ),
+            "value * 0.9144", "value / 0.9144" );
+        QVERIFY( !converter.CanConvert( "yd", "Foot" ) );
+        system_p->SetSymbol( system_p->GetUnit( "Yard" ), "yd" );
+        QVERIFY( Compare( converter.Convert( "yd", "Foot", 1.0 ), 3.0 ) );
+
+        // Conversions in other dimensions are kept.
+        QVERIFY( converter.GetConversion( "Hour", "Second" ) == hours_p );
+    }
+
+    void Overlay()
+    {
+        std::auto_ptr<UnitSystem> base_p( CreateSystem() );
+        base_p->Freeze();
+        const UnitSystem *const_base_p = base_p.get();
+
+        std::auto_ptr<UnitSystem> overlay_p(
+            UnitSystem::CreateOverlay( const_base_p ) );
+        AddUnit( overlay_p.get(), "Yard", 
+            const_base_p->GetDimension( "Length" ), 
+            "value * 0.9144", "value / 0.9144" );
+        QVERIFY( overlay_p->SetSymbol( overlay_p->GetUnit( "Yard" ), "yd" ) );
+        QVERIFY( !overlay_p->SetSymbol( overlay_p->GetUnit( "Yard" ), "m" ) );
+
+        Dimension *mass_p =
+            overlay_p->NewDimension( "Mass", DimensionId( "Kilogram" ) );
+        mass_p->SetBaseUnit( overlay_p->NewUnit( "Kilogram", mass_p ) );
+        AddUnit( overlay_p.get(), "Pound", mass_p,
+            "value * 0.45359237", "value / 0.45359237" );
+
+        const UnitSystem *const_overlay_p = overlay_p.get();
+        QVERIFY( const_overlay_p->GetUnit( "Mile" ) ==
+            const_base_p->GetUnit( "Mile" ) );
+        QVERIFY( const_overlay_p->GetUnitBySymbol( "ft" ) ==
+            const_base_p->GetUnit( "Foot" ) );
+        QCOMPARE( const_overlay_p->Units().count(), 12 );
+        QCOMPARE( const_base_p->Units().count(), 9 );
+        QVERIFY( !const_base_p->GetUnit( "Yard" ) );
+        QCOMPARE( const_base_p->GetDimension( "Length" )->UnitCount(), 3 );
+
+        // The mutable interface only hands out what the overlay owns.
+        QVERIFY( !overlay_p->GetUnit( "Mile" ) );
+        QVERIFY( !overlay_p->GetDimension( "Length" ) );
+        QVERIFY( !overlay_p->GetDimension( DimensionId( "Meter" ) ) );
+        QVERIFY( !overlay_p->GetUnit( "Yard" )->GetDimension() );
+        QVERIFY( overlay_p->GetDimension( "Mass" ) == mass_p );
+        QVERIFY( overlay_p->GetUnit( "Pound" )->GetDimension() == mass_p );
+
+        Converter converter( const_overlay_p );
+        QVERIFY( Compare( converter.Convert( "yd", "ft", 1.0 ), 3.0 ) );
+        QVERIFY( Compare( converter.Convert( "Mile", "Yard", 1.0 ), 1760.0 ) );
+        QVERIFY( Compare( converter.Convert( "Kiloyard", "m", 1.0 ), 914.4 ) );
+        QVERIFY( Compare( converter.Convert( "yd / s", "ft / s", 1.0 ), 3.0 ) );
+        QVERIFY( Compare( converter.Convert( "Pound", "Kilogram", 1.0 ),
+            0.45359237 ) );
+    }
+
+    void SaveAndLoad()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+
+        {
+            Converter converter( system_p.get() );
+            converter.GetConversion( "Mile", "Foot" );
+            converter.GetConversion( "Fahrenheit", "Kelvin" );
+            QVERIFY( converter.Save( CachePath() ) );
+        }
+
+        Converter converter( system_p.get() );
+        QVERIFY( converter.Load( CachePath() ) );
+        QVERIFY( Compare( converter.Convert( "Mile", "Foot", 1.0 ), 5280.0 ) );
+        QVERIFY( Compare(
+            converter.Convert( "Fahrenheit", "Kelvin", 32.0 ), 273.15 ) );
+
+        QFile::remove( CachePath() );
+    }
+
+    void LoadChangedSystem()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+
+        {
+            Converter converter( system_p.get() );
+            converter.GetConversion( "Mile", "Foot" );
+            QVERIFY( converter.Save( CachePath() ) );
+        }
+
+        std::auto_ptr<UnitSystem> changed_p( CreateSystem() );
+        changed_p->GetUnit( "Mile" )->SetToBase(
+            ParseConversion( "value * 1609.3" ) );
+
+        const UnitSystem *const_changed_p = changed_p.get();
+        Converter converter( const_changed_p );
+        QVERIFY( !converter.Load( CachePath() ) );
+        QVERIFY( Compare(
+            converter.Convert( "Mile", "Meter", 1.0 ), 1609.3 ) );
+
+        QFile::remove( CachePath() );
+    }
+
+    void Snapshot()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        QVERIFY( system_p->Save( CachePath() ) );
+
+        std::auto_ptr<const UnitSystem> loaded_p( 
+            UnitSystem::Load( CachePath() ) );
+        QVERIFY( loaded_p.get() );
+        QCOMPARE( loaded_p->Fingerprint(), system_p->Fingerprint() );
+
+        const Dimension *speed_p = loaded_p->GetDimension( "Speed" );
+        QVERIFY( speed_p );
+        QCOMPARE( speed_p->GetBaseUnit()->Name(), QString( "MeterPerSecond" ) );
+        QVERIFY( loaded_p->Divide( loaded_p->GetDimension( "Length" ), 
+            loaded_p->GetDimension( "Time" ) ) == speed_p );
+        QCOMPARE( loaded_p->GetUnitBySymbol( "ft" )->Name(), 
+            QString( "Foot" ) );
+
+        QStringList names;
+        QStringList loaded_names;
+        QList<const Unit*> units( system_p->Units() );
+        QList<const Unit*> loaded_units( loaded_p->Units() );
+        for ( int i = 0; i < units.count(); ++i )
+        {
+            names << units[i]->Name() + " " + units[i]->Symbol();
+        }
+        for ( int i = 0; i < loaded_units.count(); ++i )
+        {
+            loaded_names << loaded_units[i]->Name() + " " + 
+                loaded_units[i]->Symbol();
+        }
+        names.sort();
+        loaded_names.sort();
+        QCOMPARE( loaded_names, names );
+
+        Converter converter( loaded_p.get() );
+        QVERIFY( Compare( converter.Convert( "mi", "ft", 1.0 ), 5280.0 ) );
+        QVERIFY( Compare(
+            converter.Convert( "Fahrenheit", "Kelvin", 32.0 ), 273.15 ) );
+
+        // A damaged snapshot fails its checksum. The loaded system maps the
+        // snapshot, so damage a copy.
+        QFile file( CachePath() );
+        QVERIFY( file.open( QIODevice::ReadOnly ) );
+        QByteArray contents( file.readAll() );
+        file.close();
+        contents[contents.size() - 1] = ~contents[contents.size() - 1];
+
+        QFile damaged( CachePath() + ".damaged" );
+        QVERIFY( damaged.open( QIODevice::WriteOnly ) );
+        damaged.write( contents );
+        damaged.close();
+        QVERIFY( !UnitSystem::Load( damaged.fileName() ).get() );
+        QFile::remove( damaged.fileName() );
+
+        // A cache file is not a snapshot.
+        converter.Save( CachePath() );
+        QVERIFY( !UnitSystem::Load( CachePath() ).get() );
+
+        QFile::remove( CachePath() );
+    }
+
+    void LoadMissingFile()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+
+        QVERIFY( !converter.Load( CachePath() + ".missing" ) );
+    }
+
+    void ReadDeepConversion()
+    {
+        // A long run of add tags would nest without end.
+        QByteArray contents( 100000, char( 2 ) );
+        QDataStream in( contents );
+        Conversion::AutoPtr conv_p;
+        in >> conv_p;
+        QVERIFY( !conv_p.get() );
+        QVERIFY( in.status() != QDataStream::Ok );
+
+        // A conversion written by the library reads back.
+        QByteArray written;
+        QDataStream out( &written, QIODevice::WriteOnly );
+        out << *ParseConversion( "(value + 459.67) * 5.0 / 9.0" );
+        QDataStream reread( written );
+        reread >> conv_p;
+        QVERIFY( conv_p.get() );
+        QVERIFY( Compare( conv_p->Eval( 32.0 ), 273.15 ) );
+    }
+
+    void SaveReplacesFile()
+    {
+        std::auto_ptr<const UnitSystem> system_p( CreateSystem().release() );
+        Converter converter( system_p.get() );
+        converter.GetConversion( "Mile", "Foot" );
+
+        QVERIFY( converter.Save( CachePath() ) );
+        QVERIFY( converter.Save( CachePath() ) );
+        QVERIFY( QFile::exists( CachePath() ) );
+        QVERIFY( !QFile::exists( CachePath() + ".tmp" ) );
+        QVERIFY( converter.Load( CachePath() ) );
+
+        QFile::remove( CachePath() );
+    }
+};
+
+#include "ConverterTests.moc"
+
+static Test<ConverterTests> s_test;
@@ -270,6 +270,26 @@ private slots:
 
         QVERIFY( id0 == id1 );
     }
+
+    void Hash()
+    {
+        DimensionId id0 = ParseDerivation( "M * S / S" );
+        DimensionId id1 = ParseDerivation( "M" );
+        DimensionId id2 = ParseDerivation( "A * B * C" );
+        DimensionId id3 = ParseDerivation( "C * B * A" );
+
+        QCOMPARE( qHash( id0 ), qHash( id1 ) );
+        QCOMPARE( qHash( id2 ), qHash( id3 ) );
+        QCOMPARE( qHash( ParseDerivation( "M / M" ) ), qHash( DimensionId() ) );
+
+        QHash<DimensionId,int> ids;
+        ids.insert( id1, 1 );
+        ids.insert( id2, 2 );
+
+        QCOMPARE( ids.value( id0 ), 1 );
+        QCOMPARE( ids.value( id3 ), 2 );
+        QVERIFY( !ids.contains( ParseDerivation( "M * S" ) ) );
+    }
 };
 
 #include "DerivationParserTests.moc"
@@ -0,0 +1,150 @@
+#include <QtTest/QtTest>
+#include <cmath>
+
+#include "Test.h"
+
+#include "Converter.h"
+#include "Reloader.h"
+#include "UnitSystem.h"
+
+using namespace AutoUnits;
+
+//==============================================================================
+/// A thread that gets its converter from a generation and converts with it.
+///
+class ConverterUser : public QThread
+{
+public:
+    ConverterUser( Reloader::Handle generation ) :
+        m_converter_p( NULL ), m_result( 0.0 ), m_generation( generation )
+    {
+    }
+
+    const Converter *m_converter_p;
+    double m_result;
+
+protected:
+    virtual void run()
+    {
+        m_converter_p = &m_generation->GetConverter();
+        m_result = m_converter_p->Convert( "Foot", "Meter", 1.0 );
+    }
+
+private:
+    Reloader::Handle m_generation;
+};
+
+class ReloaderTests : public QObject
+{
+    Q_OBJECT;
+
+private:
+    bool Compare( double l, double r )
+    {
+        return std::abs( l - r ) < ( 1.0e-10 );
+    }
+
+    QString DefinitionsPath()
+    {
+        return QDir::temp().filePath( "AutoUnitsReloaderTests.yaml" );
+    }
+
+    bool WriteDefinitions( double foot )
+    {
+        QFile file( DefinitionsPath() );
+        if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        {
+            return false;
+        }
+
+        QTextStream out( &file );
+        out << "BaseDimensions:\n"
+            << "  - name: Length\n"
+            << "    unit: Meter\n"
+            << "    symbol: m\n"
+            << "DerivedDimensions: []\n"
+            << "ConvertedUnits:\n"
+            << "  - name: Foot\n"
+            << "    symbol: ft\n"
+            << "    dimension: Length\n"
+            << "    conversion: " << foot << "\n";
+        return true;
+    }
+
+    /// The application, if the tests had to create one for the event loop.
+    std::auto_ptr<QCoreApplication> m_app_p;
+
+private slots:
+    void initTestCase()
+    {
+        if ( !QCoreApplication::instance() )
+        {
+            static int argc = 1;
+            static char name[] = "Tests";
+            static char *argv[] = { name, NULL };
+            m_app_p.reset( new QCoreApplication( argc, argv ) );
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        QFile::remove( DefinitionsPath() );
+    }
+
+    void PerThreadConverters()
+    {
+        QVERIFY( WriteDefinitions( 0.3048 ) );
+        Reloader reloader( DefinitionsPath() );
+        Reloader::Handle generation( reloader.Current() );
+        QVERIFY( generation );
+
+        const Converter *converter_p = &generation->GetConverter();
+        QCOMPARE( &generation->GetConverter(), converter_p );
+
+        ConverterUser first( generation );
+        ConverterUser second( generation );
+        first.start();
+        second.start();
+        first.wait();
+        second.wait();
+
+        QVERIFY( first.m_converter_p != converter_p );
+        QVERIFY( second.m_converter_p != converter_p );
+        QVERIFY( first.m_converter_p != second.m_converter_p );
+        QVERIFY( Compare( first.m_result, 0.3048 ) );
+        QVERIFY( Compare( second.m_result, 0.3048 ) );
+    }
+
+    void ReloadOnChange()
+    {
+        QVERIFY( WriteDefinitions( 0.3048 ) );
+        Reloader reloader( DefinitionsPath() );
+        QSignalSpy spy( &reloader, SIGNAL( Reloaded() ) );
+
+        Reloader::Handle old_generation( reloader.Current() );
+        QVERIFY( old_generation );
+
+        QVERIFY( WriteDefinitions( 0.3 ) );
+        for ( int i = 0; ( i < 50 ) && spy.isEmpty(); ++i )
+        {
+            QTest::qWait( 100 );
+        }
+        QVERIFY( !spy.isEmpty() );
+
+        Reloader::Handle new_generation( reloader.Current() );
+        QVERIFY( new_generation != old_generation );
+        QVERIFY( Compare( new_generation->GetConverter().Convert(
+            "Foot", "Meter", 1.0 ), 0.3 ) );
+
+        // The old generation is unchanged, and valid for as long as it is
+        // held.
+        QVERIFY( Compare( old_generation->GetConverter().Convert(
+            "Foot", "Meter", 1.0 ), 0.3048 ) );
+        QVERIFY( old_generation->System()->GetUnit( "Foot" ) );
+        QVERIFY( old_generation->System() != new_generation->System() );
+    }
+};
+
+#include "ReloaderTests.moc"
+
+static Test<ReloaderTests> s_test;
@@ -20,7 +20,9 @@ HEADERS += \
 
 SOURCES += \
     ConversionParserTests.cpp \
+    ConverterTests.cpp \
     DerivationParserTests.cpp \
+    ReloaderTests.cpp \
     TestMain.cpp \
 
 run.commands = $$OUT_PWD/$$DESTDIR/$$TARGET
@@ -5,9 +5,12 @@
 ///
 //==============================================================================
 
+#include <new>
+
 #include <QTextStream>
 
 #include "Types/Conversion.h"
+#include "Util/Arena.h"
 
 namespace AutoUnits
 {
@@ -131,6 +134,251 @@ private:
     /// The output stream.
     QTextStream m_stream;
 };
+
+//==============================================================================
+/// The visitor we use to reduce conversions to the form scale * x + offset.
+/// 
+class AffineReducer : public ConstVisitor
+{
+public:
+    //==========================================================================
+    /// Constructor.
+    /// 
+    /// \param[in] node The node to reduce.
+    /// 
+    AffineReducer( const Conversion& node ) : 
+        m_scale( 0.0 ), m_offset( 0.0 ), m_is_affine( true )
+    {
+        node.Accept( *this );
+    }
+
+    //==========================================================================
+    /// Check whether the node was affine.
+    /// 
+    /// \return True if the node was affine.
+    /// 
+    bool IsAffine() const { return m_is_affine; }
+
+    //==========================================================================
+    /// Get the scale of the reduced node.
+    /// 
+    /// \return The scale.
+    /// 
+    double Scale() const { return m_scale; }
+
+    //==========================================================================
+    /// Get the offset of the reduced node.
+    /// 
+    /// \return The offset.
+    /// 
+    double Offset() const { return m_offset; }
+
+    //==========================================================================
+    /// Visit a constant node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const Constant& node ) 
+    {
+        m_scale = 0.0;
+        m_offset = node.Value();
+    }
+    
+    //==========================================================================
+    /// Visit a value node.
+    /// 
+    virtual void Visit( const Value& )
+    {
+        m_scale = 1.0;
+        m_offset = 0.0;
+    }
+
+    //==========================================================================
+    /// Visit an add node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const AddOp& node )
+    {
+        AffineReducer lhs( *node.GetLeft() );
+        AffineReducer rhs( *node.GetRight() );
+
+        m_is_affine = lhs.m_is_affine && rhs.m_is_affine;
+        m_scale = lhs.m_scale + rhs.m_scale;
+        m_offset = lhs.m_offset + rhs.m_offset;
+    }
+
+    //==========================================================================
+    /// Visit a sub node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const SubOp& node )
+    {
+        AffineReducer lhs( *node.GetLeft() );
+        AffineReducer rhs( *node.GetRight() );
+
+        m_is_affine = lhs.m_is_affine && rhs.m_is_affine;
+        m_scale = lhs.m_scale - rhs.m_scale;
+        m_offset = lhs.m_offset - rhs.m_offset;
+    }
+
+    //==========================================================================
+    /// Visit a mutliply node. The product is only affine if one side is 
+    /// constant.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const MultOp& node )
+    {
+        AffineReducer lhs( *node.GetLeft() );
+        AffineReducer rhs( *node.GetRight() );
+
+        m_is_affine = lhs.m_is_affine && rhs.m_is_affine && 
+            ( ( lhs.m_scale == 0.0 ) || ( rhs.m_scale == 0.0 ) );
+        m_scale = lhs.m_scale * rhs.m_offset + lhs.m_offset * rhs.m_scale;
+        m_offset = lhs.m_offset * rhs.m_offset;
+    }
+
+    //==========================================================================
+    /// Visit a div node. The quotient is only affine if the divisor is 
+    /// constant.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const DivOp& node )
+    {
+        AffineReducer lhs( *node.GetLeft() );
+        AffineReducer rhs( *node.GetRight() );
+
+        m_is_affine = lhs.m_is_affine && rhs.m_is_affine && 
+            ( rhs.m_scale == 0.0 ) && ( rhs.m_offset != 0.0 );
+        m_scale = m_is_affine ? lhs.m_scale / rhs.m_offset : 0.0;
+        m_offset = m_is_affine ? lhs.m_offset / rhs.m_offset : 0.0;
+    }
+
+private:
+    /// Not implemented.
+    AffineReducer();
+    /// Not implemented.
+    AffineReducer( const AffineReducer& );
+    /// Not implemented.
+    AffineReducer& operator=( const AffineReducer& );
+
+    /// The scale of the reduced node.
+    double m_scale;
+    /// The offset of the reduced node.
+    double m_offset;
+    /// Whether the node is affine.
+    bool m_is_affine;
+};
+
+//==============================================================================
+/// The visitor we use to copy conversions into an arena.
+/// 
+class ArenaCopier : public ConstVisitor
+{
+public:
+    //==========================================================================
+    /// Constructor.
+    /// 
+    /// \param[in] node The node to copy.
+    /// \param[in] arena_p The arena to copy it into.
+    /// 
+    ArenaCopier( const Conversion& node, Util::Arena *arena_p ) : 
+        m_arena_p( arena_p ), m_copy_p( NULL )
+    {
+        node.Accept( *this );
+    }
+
+    //==========================================================================
+    /// Get the copy.
+    /// 
+    /// \return The copy.
+    /// 
+    Conversion *Copy() const { return m_copy_p; }
+
+    //==========================================================================
+    /// Visit a constant node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const Constant& node ) 
+    {
+        m_copy_p = new ( m_arena_p->Allocate( sizeof( Constant ) ) ) 
+            Constant( node.Value() );
+    }
+    
+    //==========================================================================
+    /// Visit a value node.
+    /// 
+    virtual void Visit( const Value& )
+    {
+        m_copy_p = new ( m_arena_p->Allocate( sizeof( Value ) ) ) Value();
+    }
+
+    //==========================================================================
+    /// Visit an add node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const AddOp& node ) { CopyBinOp( node ); }
+
+    //==========================================================================
+    /// Visit a sub node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const SubOp& node ) { CopyBinOp( node ); }
+
+    //==========================================================================
+    /// Visit a mutliply node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const MultOp& node ) { CopyBinOp( node ); }
+
+    //==========================================================================
+    /// Visit a div node.
+    /// 
+    /// \param [in] node The node to visit.
+    /// 
+    virtual void Visit( const DivOp& node ) { CopyBinOp( node ); }
+
+private:
+    /// Not implemented.
+    ArenaCopier();
+    /// Not implemented.
+    ArenaCopier( const ArenaCopier& );
+    /// Not implemented.
+    ArenaCopier& operator=( const ArenaCopier& );
+
+    //==========================================================================
+    /// Copy a binary operator node. The copy owns its children through 
+    /// auto_ptrs as usual, but since it is never destroyed, they never free
+    /// the arena's memory.
+    /// 
+    /// \tparam Op The type of the node.
+    /// 
+    /// \param [in] node The node to copy.
+    /// 
+    template<class Op>
+    void CopyBinOp( const Op& node )
+    {
+        Conversion::AutoPtr lhs_p( 
+            ArenaCopier( *node.GetLeft(), m_arena_p ).Copy() );
+        Conversion::AutoPtr rhs_p( 
+            ArenaCopier( *node.GetRight(), m_arena_p ).Copy() );
+        m_copy_p = new ( m_arena_p->Allocate( sizeof( Op ) ) ) 
+            Op( lhs_p, rhs_p );
+    }
+
+    /// The arena.
+    Util::Arena *m_arena_p;
+    /// The copy.
+    Conversion *m_copy_p;
+};
+
 } // namespace
 
 //==============================================================================
@@ -451,6 +699,47 @@ Conversion::AutoPtr Compose(
     return f->Compose( *g );
 }
 
+//==============================================================================
+/// Reduce a conversion to the form f(x) = scale * x + offset, if possible.
+/// Affine conversions can be evaluated without walking the conversion tree,
+/// which is much cheaper when converting many values at once.
+/// 
+/// \param [in] conv The conversion.
+/// \param [out] scale_p The scale, if the conversion is affine.
+/// \param [out] offset_p The offset, if the conversion is affine.
+/// 
+/// \return True if the conversion is affine.
+/// 
+bool GetAffine( const Conversion& conv, double *scale_p, double *offset_p )
+{
+    AffineReducer reducer( conv );
+
+    if ( !reducer.IsAffine() )
+    {
+        return false;
+    }
+
+    *scale_p = reducer.Scale();
+    *offset_p = reducer.Offset();
+    return true;
+}
+
+//==============================================================================
+/// Copy a conversion into an arena. Building and freeing many small trees 
+/// one node at a time is slow, so a unit system keeps its units' 
+/// conversions in its arena and releases them all at once.
+/// 
+/// \param [in] conv The conversion.
+/// \param [in] arena_p The arena.
+/// 
+/// \return The copy. It must never be deleted or destroyed, and is valid 
+///         until the arena is destroyed.
+/// 
+Conversion *CopyToArena( const Conversion& conv, Util::Arena *arena_p )
+{
+    return ArenaCopier( conv, arena_p ).Copy();
+}
+
 } // namespace Conversions
 
 } // namespace AutoUnits
@@ -12,6 +12,11 @@
 namespace AutoUnits
 {
 
+namespace Util
+{
+class Arena;
+}
+
 namespace Conversions 
 {
 class Visitor;
@@ -393,6 +398,8 @@ public:
 Conversion::AutoPtr Compose( const Conversion& f, const Conversion& g );
 Conversion::AutoPtr Compose( 
     const Conversion::AutoPtr& f, const Conversion::AutoPtr& g );
+bool GetAffine( const Conversion& conv, double *scale_p, double *offset_p );
+Conversion *CopyToArena( const Conversion& conv, Util::Arena *arena_p );
 
 } // namespace Conversions
 
@@ -67,12 +67,19 @@ DimensionId::DimensionId( const QString& dim )
 /// 
 bool DimensionId::operator==( const DimensionId& rhs ) const
 {
-    QSet<QString> all_keys = AllKeys( *this, rhs );
+    // Missing keys count as zero, so check the non-zero entries of each side
+    // against the other.
+    for ( const_iterator it = begin(); it != end(); ++it )
+    {
+        if ( ( it.value() != 0 ) && ( rhs.value( it.key() ) != it.value() ) )
+        {
+            return false;
+        }
+    }
 
-    for ( QSet<QString>::const_iterator it = all_keys.begin(); 
-        it != all_keys.end(); ++it )
+    for ( const_iterator it = rhs.begin(); it != rhs.end(); ++it )
     {
-        if ( operator[]( *it ) != rhs[*it] )
+        if ( ( it.value() != 0 ) && ( value( it.key() ) != it.value() ) )
         {
             return false;
         }
@@ -122,4 +129,29 @@ DimensionId DimensionId::operator^( int exp ) const
     return result;
 }
 
+//==============================================================================
+/// Compute a hash value for a dimension id. Entries with a zero exponent are
+/// ignored, consistent with DimensionId::operator==, and the result doesn't 
+/// depend on the order of the entries.
+/// 
+/// \param [in] id The dimension id.
+/// 
+/// \return The hash value.
+/// 
+uint qHash( const DimensionId& id )
+{
+    uint result = 0;
+
+    for ( DimensionId::const_iterator it = id.begin(); it != id.end(); ++it )
+    {
+        if ( it.value() != 0 )
+        {
+            result += 
+                ::qHash( it.key() ) ^ ( uint( it.value() ) * 0x9E3779B9u );
+        }
+    }
+
+    return result;
+}
+
 } // namespace AutoUnits
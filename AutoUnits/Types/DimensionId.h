@@ -27,6 +27,8 @@ public:
     DimensionId operator^( int exp ) const;
 };
 
+uint qHash( const DimensionId& id );
+
 } // namespace AutoUnits
 
 #endif // AUTO_UNITS_TYPES_DIMENSION_ID_H
@@ -0,0 +1,188 @@
+//==============================================================================
+/// \file AutoUnits/Types/PackedDimensionId.cpp
+/// 
+/// Source file for the PackedDimensionId type.
+///
+//==============================================================================
+
+#include <cassert>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Types/PackedDimensionId.h"
+
+namespace AutoUnits
+{
+
+//==============================================================================
+/// Construct the id of a scalar (all exponents zero).
+/// 
+PackedDimensionId::PackedDimensionId()
+{
+    std::memset( m_exponents, 0, sizeof( m_exponents ) );
+}
+
+//==============================================================================
+/// Construct the id of a base dimension.
+/// 
+/// \param [in] index The index of the base dimension.
+/// 
+/// \return The id.
+/// 
+PackedDimensionId PackedDimensionId::Base( int index )
+{
+    assert( ( index >= 0 ) && ( index < MAX_BASES ) );
+
+    PackedDimensionId result;
+    result.m_exponents[index] = 1;
+    return result;
+}
+
+//==============================================================================
+/// Get the exponent of a base dimension.
+/// 
+/// \param [in] index The index of the base dimension.
+/// 
+/// \return The exponent.
+/// 
+int PackedDimensionId::Exponent( int index ) const
+{
+    assert( ( index >= 0 ) && ( index < MAX_BASES ) );
+    return m_exponents[index];
+}
+
+//==============================================================================
+/// Check whether this is the id of a scalar.
+/// 
+/// \return True if every exponent is zero.
+/// 
+bool PackedDimensionId::IsScalar() const
+{
+    return *this == PackedDimensionId();
+}
+
+//==============================================================================
+/// Equality test operator.
+/// 
+/// \param [in] rhs The right hand side.
+/// 
+/// \return True if the operands are equal.
+/// 
+bool PackedDimensionId::operator==( const PackedDimensionId& rhs ) const
+{
+#ifdef __SSE2__
+    __m128i lhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( m_exponents ) );
+    __m128i rhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( rhs.m_exponents ) );
+    return _mm_movemask_epi8( _mm_cmpeq_epi8( lhs_v, rhs_v ) ) == 0xFFFF;
+#else
+    return std::memcmp( m_exponents, rhs.m_exponents, sizeof( m_exponents ) )
+        == 0;
+#endif
+}
+
+//==============================================================================
+/// Inequality test operator.
+/// 
+/// \param [in] rhs The right hand side.
+/// 
+/// \return True if the operands are not equal.
+/// 
+bool PackedDimensionId::operator!=( const PackedDimensionId& rhs ) const
+{
+    return !( *this == rhs );
+}
+
+//==============================================================================
+/// Calculate the resulting dimension of multiplying two dimensions.
+/// 
+/// \param [in] rhs The right hand side.
+/// 
+/// \return The resulting dimension.
+/// 
+PackedDimensionId PackedDimensionId::operator*( const PackedDimensionId& rhs ) 
+    const
+{
+    PackedDimensionId result;
+#ifdef __SSE2__
+    __m128i lhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( m_exponents ) );
+    __m128i rhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( rhs.m_exponents ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( result.m_exponents ), 
+        _mm_add_epi8( lhs_v, rhs_v ) );
+#else
+    for ( int i = 0; i < MAX_BASES; ++i )
+    {
+        result.m_exponents[i] = qint8( m_exponents[i] + rhs.m_exponents[i] );
+    }
+#endif
+    return result;
+}
+
+//==============================================================================
+/// Calculate the resulting dimension of dividing two dimensions.
+/// 
+/// \param [in] rhs The right hand side.
+/// 
+/// \return The resulting dimension.
+/// 
+PackedDimensionId PackedDimensionId::operator/( const PackedDimensionId& rhs ) 
+    const
+{
+    PackedDimensionId result;
+#ifdef __SSE2__
+    __m128i lhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( m_exponents ) );
+    __m128i rhs_v = _mm_loadu_si128( 
+        reinterpret_cast<const __m128i*>( rhs.m_exponents ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( result.m_exponents ), 
+        _mm_sub_epi8( lhs_v, rhs_v ) );
+#else
+    for ( int i = 0; i < MAX_BASES; ++i )
+    {
+        result.m_exponents[i] = qint8( m_exponents[i] - rhs.m_exponents[i] );
+    }
+#endif
+    return result;
+}
+
+//==============================================================================
+/// Calculate the resulting dimension of raising a dimension to a power.
+/// 
+/// \param [in] exp The power.
+/// 
+/// \return The resulting dimension.
+/// 
+PackedDimensionId PackedDimensionId::operator^( int exp ) const
+{
+    PackedDimensionId result;
+    for ( int i = 0; i < MAX_BASES; ++i )
+    {
+        result.m_exponents[i] = qint8( m_exponents[i] * exp );
+    }
+    return result;
+}
+
+//==============================================================================
+/// Compute a hash value for a packed dimension id.
+/// 
+/// \param [in] id The dimension id.
+/// 
+/// \return The hash value.
+/// 
+uint qHash( const PackedDimensionId& id )
+{
+    uint result = 0;
+    for ( int i = 0; i < PackedDimensionId::MAX_BASES; ++i )
+    {
+        result = result * 31 + uint( quint8( id.Exponent( i ) ) );
+    }
+    return result;
+}
+
+} // namespace AutoUnits
@@ -0,0 +1,52 @@
+#ifndef AUTO_UNITS_TYPES_PACKED_DIMENSION_ID_H
+#define AUTO_UNITS_TYPES_PACKED_DIMENSION_ID_H
+//==============================================================================
+/// \file AutoUnits/Types/PackedDimensionId.h
+/// 
+/// Header file for the PackedDimensionId type.
+///
+//==============================================================================
+
+#include <QtGlobal>
+
+namespace AutoUnits
+{
+
+//==============================================================================
+/// A compact form of DimensionId for arithmetic on hot paths. The unit system
+/// numbers its base dimensions densely, and the id stores the exponent of 
+/// each base dimension as one byte in a fixed 16 byte array. Multiplication,
+/// division and comparison never allocate, and use single SSE2 instructions
+/// where available.
+/// 
+/// \note Exponents must stay within the range of a signed byte.
+/// 
+class PackedDimensionId
+{
+public:
+    /// The maximum number of base dimensions.
+    enum { MAX_BASES = 16 };
+
+    PackedDimensionId();
+    static PackedDimensionId Base( int index );
+
+    int Exponent( int index ) const;
+    bool IsScalar() const;
+
+    bool operator==( const PackedDimensionId& rhs ) const;
+    bool operator!=( const PackedDimensionId& rhs ) const;
+
+    PackedDimensionId operator*( const PackedDimensionId& rhs ) const;
+    PackedDimensionId operator/( const PackedDimensionId& rhs ) const;
+    PackedDimensionId operator^( int exp ) const;
+
+private:
+    /// The exponent of each base dimension.
+    qint8 m_exponents[MAX_BASES];
+};
+
+uint qHash( const PackedDimensionId& id );
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_TYPES_PACKED_DIMENSION_ID_H
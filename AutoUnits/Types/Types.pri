@@ -1,8 +1,10 @@
 HEADERS += \
     Types/Conversion.h \
     Types/DimensionId.h \
+    Types/PackedDimensionId.h \
 
 SOURCES += \
     Types/Conversion.cpp \
     Types/DimensionId.cpp \
+    Types/PackedDimensionId.cpp \
 
@@ -18,7 +18,29 @@ namespace AutoUnits
 /// 
 QString Unit::Name() const
 {
-    return m_name;
+    return Util::AtomTable::Text( m_name_atom );
+}
+
+//==============================================================================
+/// Get the atom for the unit's name, normalized as the unit system 
+/// normalizes names for lookup. Units with the same name have the same atom,
+/// so names can be compared as integers.
+/// 
+/// \return The atom.
+/// 
+Util::Atom Unit::NameAtom() const
+{
+    return Util::AtomTable::Normalized( m_name_atom );
+}
+
+//==============================================================================
+/// Get the symbol of the unit.
+/// 
+/// \return The symbol, or an empty string if the unit has no symbol.
+/// 
+QString Unit::Symbol() const
+{
+    return m_symbol_atom ? Util::AtomTable::Text( m_symbol_atom ) : QString();
 }
 
 //==============================================================================
@@ -38,7 +60,7 @@ const Dimension *Unit::GetDimension() const
 /// 
 const Conversion *Unit::ToBase() const
 {
-    return m_to_base_p.get();
+    return m_to_base_p;
 }
 
 
@@ -49,7 +71,7 @@ const Conversion *Unit::ToBase() const
 /// 
 const Conversion *Unit::FromBase() const
 {
-    return m_from_base_p.get();
+    return m_from_base_p;
 }
 
 //==============================================================================
@@ -62,6 +84,18 @@ bool Unit::IsBase() const
     return m_dim_p->GetBaseUnit() == this;
 }
 
+//==============================================================================
+/// Get the index of the unit within its dimension. Units are numbered 
+/// densely in the order they were added to the dimension, so the index can be
+/// used to look up per-unit data in a table for the dimension.
+/// 
+/// \return The index, or -1 if the unit isn't in its dimension's unit list.
+/// 
+int Unit::Index() const
+{
+    return m_index;
+}
+
 //==============================================================================
 /// Get the conversion to the base unit.
 /// 
@@ -69,7 +103,7 @@ bool Unit::IsBase() const
 /// 
 Conversion *Unit::ToBase() 
 {
-    return m_to_base_p.get();
+    return m_to_base_p;
 }
 
 //==============================================================================
@@ -79,37 +113,44 @@ Conversion *Unit::ToBase()
 /// 
 Conversion *Unit::FromBase() 
 {
-    return m_from_base_p.get();
+    return m_from_base_p;
 }
 
 //==============================================================================
-/// Set the to-base conversion.
+/// Set the to-base conversion. The conversion is copied into the unit's 
+/// arena; the old one stays there, since readers may still be using it.
 /// 
 /// \param [in] conv_p The conversion.
 /// 
 void Unit::SetToBase( std::auto_ptr<Conversion> conv_p )
 {
-    m_to_base_p.reset( conv_p.release() );
+    m_to_base_p = Conversions::CopyToArena( *conv_p, m_arena_p );
+    Touch();
 }
 
 //==============================================================================
-/// Set the from-base conversion.
+/// Set the from-base conversion. The conversion is copied into the unit's
+/// arena; the old one stays there, since readers may still be using it.
 /// 
 /// \param [in] conv_p The conversion.
 /// 
 void Unit::SetFromBase( std::auto_ptr<Conversion> conv_p )
 {
-    m_from_base_p.reset( conv_p.release() );
+    m_from_base_p = Conversions::CopyToArena( *conv_p, m_arena_p );
+    Touch();
 }
 
 //==============================================================================
 /// Get the dimension for the unit.
 /// 
-/// \return The dimension.
+/// \return The dimension, or NULL if the unit isn't in the dimension's unit
+///         list, as for an overlay's unit in a dimension of the base system.
 /// 
 Dimension *Unit::GetDimension() 
 {
-    return m_dim_p;
+    // A unit in the dimension's unit list belongs to the same system as the
+    // dimension, so the dimension may be changed through it.
+    return ( m_index >= 0 ) ? const_cast<Dimension*>( m_dim_p ) : NULL;
 }
 
 //==============================================================================
@@ -117,13 +158,20 @@ Dimension *Unit::GetDimension()
 /// 
 /// \param [in] name The name of the unit.
 /// \param [in] dimension_p The dimension for the unit.
-/// 
-Unit::Unit( const QString& name, Dimension *dimension_p ) : 
-    m_name( name ), m_dim_p( dimension_p ), 
-    m_to_base_p( new Conversions::Value() ), 
-    m_from_base_p( new Conversions::Value() )
+/// \param [in] index The index the unit will have in the dimension's unit 
+///        list, which the caller adds it to, or -1 if it isn't listed, as for
+///        an overlay's unit in a dimension of the base system.
+/// \param [in] arena_p The arena to allocate conversions from.
+/// 
+Unit::Unit( const QString& name, const Dimension *dimension_p, int index,
+    Util::Arena *arena_p ) : 
+    m_name_atom( Util::AtomTable::Intern( name ) ), m_symbol_atom( 0 ), 
+    m_dim_p( dimension_p ), 
+    m_index( index ), 
+    m_arena_p( arena_p ), 
+    m_to_base_p( Conversions::CopyToArena( Conversions::Value(), arena_p ) ), 
+    m_from_base_p( Conversions::CopyToArena( Conversions::Value(), arena_p ) )
 {
-    m_dim_p->AddUnit( this );
 }
 
 //==============================================================================
@@ -131,16 +179,59 @@ Unit::Unit( const QString& name, Dimension *dimension_p ) :
 /// 
 /// \param [in] name The name of the unit.
 /// \param [in] dimension_p The dimension for the unit.
+/// \param [in] arena_p The arena to allocate conversions from.
 /// \param [in] to_base_p The conversion to the base unit.
 /// \param [in] from_base_p The conversion from the base unit.
 /// 
 Unit::Unit( const QString& name, Dimension *dimension_p, 
-    std::auto_ptr<Conversion> to_base_p, 
+    Util::Arena *arena_p, std::auto_ptr<Conversion> to_base_p, 
     std::auto_ptr<Conversion> from_base_p ) : 
-    m_name( name ), m_dim_p( dimension_p ), 
-    m_to_base_p( to_base_p ), m_from_base_p( from_base_p )
+    m_name_atom( Util::AtomTable::Intern( name ) ), m_symbol_atom( 0 ), 
+    m_dim_p( dimension_p ), 
+    m_index( dimension_p->UnitCount() ), 
+    m_arena_p( arena_p ), 
+    m_to_base_p( Conversions::CopyToArena( *to_base_p, arena_p ) ), 
+    m_from_base_p( Conversions::CopyToArena( *from_base_p, arena_p ) )
+{
+    dimension_p->AddUnit( this );
+}
+
+//==============================================================================
+/// Constructor for a unit that is a multiple of another unit, such as a 
+/// prefixed unit. The new unit is not added to the dimension's unit list, 
+/// so its index is -1.
+/// 
+/// \param [in] name The name of the unit.
+/// \param [in] unit The unit this is a multiple of.
+/// \param [in] factor The number of \c unit in one of the new unit.
+/// \param [in] arena_p The arena to allocate conversions from.
+/// 
+Unit::Unit( const QString& name, const Unit& unit, double factor, 
+    Util::Arena *arena_p ) : 
+    m_name_atom( Util::AtomTable::Intern( name ) ), m_symbol_atom( 0 ), 
+    m_dim_p( unit.m_dim_p ), 
+    m_index( -1 ), 
+    m_arena_p( arena_p ), 
+    m_to_base_p( Conversions::CopyToArena( *Conversions::Compose( 
+        *unit.ToBase(), *Conversion::ScaleFactor( factor ) ), arena_p ) ), 
+    m_from_base_p( Conversions::CopyToArena( *Conversions::Compose( 
+        *Conversion::ScaleFactor( 1.0 / factor ), *unit.FromBase() ), 
+        arena_p ) )
+{
+}
+
+//==============================================================================
+/// Record that the unit's conversions changed. Units outside their 
+/// dimension's unit list don't change its version, since the dimension may
+/// belong to a shared base system.
+/// 
+void Unit::Touch()
 {
-    m_dim_p->AddUnit( this );
+    Dimension *dim_p = GetDimension();
+    if ( dim_p )
+    {
+        dim_p->Touch();
+    }
 }
 
 } // namespace AutoUnits
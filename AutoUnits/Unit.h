@@ -1,3 +1,5 @@
+#ifndef AUTO_UNITS_UNIT_H
+#define AUTO_UNITS_UNIT_H
 //==============================================================================
 /// \file AutoUnits/Unit.h
 /// 
@@ -8,15 +10,25 @@
 #include <QString>
 
 #include "Types/Conversion.h"
+#include "Util/AtomTable.h"
 
 namespace AutoUnits
 {
 
 class Dimension;
 
+namespace Util
+{
+class Arena;
+}
+
 //==============================================================================
 /// An object that specifies a base unit in a unit system.
 /// 
+/// Units and their conversions are allocated from their system's arena and
+/// are never destroyed one by one; the system releases the arena instead. A
+/// unit therefore holds nothing that needs a destructor.
+/// 
 class Unit
 {
 public:
@@ -24,10 +36,13 @@ public:
     /// Immutable interface.
     //==========================================================================
     QString Name() const;
+    Util::Atom NameAtom() const;
+    QString Symbol() const;
     const Dimension *GetDimension() const;
     const Conversion *ToBase() const;
     const Conversion *FromBase() const;
     bool IsBase() const;
+    int Index() const;
 
     //==========================================================================
     /// Mutable interface.
@@ -39,22 +54,35 @@ public:
     void SetFromBase( std::auto_ptr<Conversion> conv_p );
 
 private:
-    Unit( const QString& name, Dimension *dimension_p );
-    Unit( const QString& name, Dimension *dimension_p, 
+    Unit( const QString& name, const Dimension *dimension_p, int index,
+        Util::Arena *arena_p );
+    Unit( const QString& name, Dimension *dimension_p, Util::Arena *arena_p,
         std::auto_ptr<Conversion> to_base, 
         std::auto_ptr<Conversion> from_base );
+    Unit( const QString& name, const Unit& unit, double factor, 
+        Util::Arena *arena_p );
+
+    void Touch();
 
     friend class UnitSystem;
 
-    /// The unit's name.
-    QString m_name;
-    /// The unit's dimension.
-    Dimension *m_dim_p;
-    /// The to-base conversion.
-    std::auto_ptr<Conversion> m_to_base_p;
-    /// The from-base conversion.
-    std::auto_ptr<Conversion> m_from_base_p;
+    /// The atom for the unit's name, as it was given.
+    Util::Atom m_name_atom;
+    /// The atom for the unit's symbol, or zero if it has none.
+    Util::Atom m_symbol_atom;
+    /// The unit's dimension. For an overlay, this may belong to the base 
+    /// system.
+    const Dimension *m_dim_p;
+    /// The unit's index within its dimension.
+    int m_index;
+    /// The arena the conversions are allocated from.
+    Util::Arena *m_arena_p;
+    /// The to-base conversion, in the arena.
+    Conversion *m_to_base_p;
+    /// The from-base conversion, in the arena.
+    Conversion *m_from_base_p;
 };
 
 } // namespace AutoUnits
 
+#endif // AUTO_UNITS_UNIT_H
@@ -5,11 +5,21 @@
 ///
 //==============================================================================
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <new>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QStringList>
 
 #include "Dimension.h"
 #include "Unit.h"
 #include "UnitSystem.h"
+#include "Util/ConversionStream.h"
+#include "Util/File.h"
 
 namespace 
 {
@@ -26,18 +36,144 @@ QString NormalizeName( const QString& name )
     return name.trimmed().toUpper();
 }
 
+using AutoUnits::Util::Atom;
+using AutoUnits::Util::AtomTable;
+
+//==============================================================================
+/// Get the atom for the normalized form of a name, interning it if needed.
+/// 
+/// \param [in] name The name.
+/// 
+/// \return The atom.
+/// 
+Atom InternName( const QString& name )
+{
+    return AtomTable::Normalized( AtomTable::Intern( name ) );
+}
+
+//==============================================================================
+/// Get the atom for the normalized form of a name without interning it. A 
+/// name that has been interned as given, as the names of units and 
+/// dimensions are, is found without normalizing it.
+/// 
+/// \param [in] name The name.
+/// 
+/// \return The atom, or zero if no system has used the name.
+/// 
+Atom FindName( const QString& name )
+{
+    Atom atom = AtomTable::Find( name );
+    return atom ? AtomTable::Normalized( atom ) : 
+        AtomTable::Find( NormalizeName( name ) );
+}
+
+//==============================================================================
+/// Get the entries of a hash keyed by name atoms, sorted by the names the 
+/// atoms stand for.
+/// 
+/// \param [in] hash The hash.
+/// 
+/// \return The names and values, sorted by name.
+/// 
+template<class T>
+QVector< QPair<QString,T*> > SortByName( const QHash<Atom,T*>& hash )
+{
+    QVector< QPair<QString,T*> > result;
+    result.reserve( hash.count() );
+
+    for ( typename QHash<Atom,T*>::const_iterator it = hash.begin(); 
+        it != hash.end(); ++it )
+    {
+        result.append( qMakePair( AtomTable::Text( it.key() ), it.value() ) );
+    }
+
+    std::sort( result.begin(), result.end() );
+    return result;
+}
+
+//==============================================================================
+/// An SI prefix.
+/// 
+struct Prefix
+{
+    /// The prefix, as it appears at the start of a unit name.
+    const char *name;
+    /// The prefix, as it appears at the start of a unit symbol.
+    const char *symbol;
+    /// The power of ten the prefix stands for.
+    int exponent;
+};
+
+//==============================================================================
+/// The SI prefixes.
+/// 
+const Prefix PREFIXES[] = 
+{
+    { "Yotta", "Y", 24 }, { "Zetta", "Z", 21 }, { "Exa", "E", 18 }, 
+    { "Peta", "P", 15 }, { "Tera", "T", 12 }, { "Giga", "G", 9 }, 
+    { "Mega", "M", 6 }, { "Kilo", "k", 3 }, { "Hecto", "h", 2 }, 
+    { "Deca", "da", 1 }, { "Deci", "d", -1 }, { "Centi", "c", -2 }, 
+    { "Milli", "m", -3 }, { "Micro", "u", -6 }, { "Nano", "n", -9 }, 
+    { "Pico", "p", -12 }, { "Femto", "f", -15 }, { "Atto", "a", -18 }, 
+    { "Zepto", "z", -21 }, { "Yocto", "y", -24 }
+};
+
+const int PREFIX_COUNT = sizeof( PREFIXES ) / sizeof( PREFIXES[0] );
+
+/// The most prefixes that can match the start of one symbol ("d" and "da")
+/// or name.
+const int MAX_PREFIX_MATCHES = 2;
+
+/// Identifies a unit system snapshot file.
+const quint32 SNAPSHOT_MAGIC = 0x41555353;
+
+/// The version of the unit system snapshot format.
+const quint32 SNAPSHOT_VERSION = 7;
+
+//==============================================================================
+/// Compute the checksum of a snapshot, which covers everything after the 
+/// checksum itself.
+/// 
+/// \param [in] contents The snapshot.
+/// \param [in] offset The byte offset of the part after the checksum.
+/// 
+/// \return The checksum.
+/// 
+QByteArray Checksum( const QByteArray& contents, int offset )
+{
+    return QCryptographicHash::hash( 
+        QByteArray::fromRawData( contents.constData() + offset, 
+            qMax( 0, contents.size() - offset ) ), 
+        QCryptographicHash::Sha1 );
+}
+
 }
 
 namespace AutoUnits
 {
 
+//==============================================================================
+/// A prefixed unit looked up so far.
+/// 
+struct UnitSystem::PrefixedEntry
+{
+    /// The unit that is prefixed.
+    const Unit *unit_p;
+    /// The index of the prefix.
+    int prefix;
+    /// The prefixed unit, or NULL until it is first built.
+    Unit *prefixed_p;
+    /// The version of the unit's dimension when the prefixed unit was built.
+    quint32 version;
+};
+
 //==============================================================================
 /// Destructor.
 /// 
 UnitSystem::~UnitSystem()
 {
-    qDeleteAll( m_dimensions );
-    qDeleteAll( m_units );
+    ClearCaches();
+    DestroyObjects();
 }
 
 //==============================================================================
@@ -50,47 +186,319 @@ std::auto_ptr<UnitSystem> UnitSystem::Create()
     return std::auto_ptr<UnitSystem>( new UnitSystem );
 }
 
+//==============================================================================
+/// Create an overlay of a unit system. The overlay starts out empty and 
+/// stores only what is added to it; everything in the base system can be
+/// looked up through it and used in its definitions. Since nothing is 
+/// copied, creating an overlay is cheap, and many overlays can share one 
+/// base.
+/// 
+/// \param [in] base_p The base system. This must be frozen, so its base 
+///        dimensions are fixed, and must outlive the overlay.
+/// 
+/// \return A pointer to the created overlay.
+///
+/// \note Overlays aren't compacted or saved; see Freeze() and Save().
+///
+std::auto_ptr<UnitSystem> UnitSystem::CreateOverlay( const UnitSystem *base_p )
+{
+    assert( base_p && base_p->m_frozen );
+    return std::auto_ptr<UnitSystem>( new UnitSystem( base_p ) );
+}
+
+//==============================================================================
+/// Load a unit system from a snapshot written by Save(). The snapshot holds
+/// the compiled system, so loading it skips parsing the definitions, 
+/// reducing derivations and compiling conversions. The loaded system is 
+/// frozen.
+/// 
+/// The snapshot is mapped into memory where possible, so it is parsed 
+/// without first being copied into a buffer. It isn't used in place: the
+/// dimensions, units and conversions are rebuilt from it in the system's 
+/// arena, and the names and symbols are interned in the process-wide atom
+/// table, so nothing refers to the snapshot once it is loaded. Each process
+/// that loads a snapshot therefore holds its own copy of the system.
+/// 
+/// The snapshot is checked against the checksum in its header, and the 
+/// loaded system takes its fingerprint from the header rather than 
+/// computing it.
+/// 
+/// \param [in] path The path of the snapshot.
+/// 
+/// \return The system, or NULL if the file couldn't be read or isn't a 
+///         valid snapshot.
+///
+std::auto_ptr<const UnitSystem> UnitSystem::Load( const QString& path )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        return std::auto_ptr<const UnitSystem>();
+    }
+
+    QByteArray contents;
+    uchar *data_p = file.map( 0, file.size() );
+    if ( data_p )
+    {
+        contents = QByteArray::fromRawData( 
+            reinterpret_cast<const char*>( data_p ), file.size() );
+    }
+    else
+    {
+        contents = file.readAll();
+    }
+
+    QDataStream in( contents );
+    in.setVersion( QDataStream::Qt_4_6 );
+
+    quint32 magic;
+    quint32 version;
+    QByteArray checksum;
+    in >> magic >> version >> checksum;
+
+    if ( ( in.status() != QDataStream::Ok ) || ( magic != SNAPSHOT_MAGIC ) ||
+        ( version != SNAPSHOT_VERSION ) || 
+        ( Checksum( contents, int( in.device()->pos() ) ) != checksum ) )
+    {
+        return std::auto_ptr<const UnitSystem>();
+    }
+
+    QByteArray fingerprint;
+    QStringList base_keys;
+    quint32 dim_count;
+    in >> fingerprint >> base_keys >> dim_count;
+
+    if ( ( in.status() != QDataStream::Ok ) ||
+        ( base_keys.count() > PackedDimensionId::MAX_BASES ) )
+    {
+        return std::auto_ptr<const UnitSystem>();
+    }
+
+    std::auto_ptr<UnitSystem> system_p( new UnitSystem );
+
+    // Restore the base dimension indices as saved, so the packed ids in the
+    // snapshot mean the same thing.
+    system_p->m_base_keys = base_keys;
+    for ( int i = 0; i < base_keys.count(); ++i )
+    {
+        system_p->m_base_indices.insert( NormalizeName( base_keys[i] ), i );
+    }
+
+    for ( quint32 i = 0; i < dim_count; ++i )
+    {
+        QString name;
+        quint32 term_count;
+        in >> name >> term_count;
+
+        DimensionId id;
+        for ( quint32 j = 0; 
+            ( j < term_count ) && ( in.status() == QDataStream::Ok ); ++j )
+        {
+            QString key;
+            qint32 exponent;
+            in >> key >> exponent;
+            id.insert( key, exponent );
+        }
+
+        PackedDimensionId packed_id;
+        for ( int j = 0; j < PackedDimensionId::MAX_BASES; ++j )
+        {
+            qint8 exponent;
+            in >> exponent;
+            if ( exponent != 0 )
+            {
+                packed_id = packed_id * 
+                    ( PackedDimensionId::Base( j ) ^ exponent );
+            }
+        }
+
+        qint32 base_index;
+        quint32 unit_count;
+        in >> base_index >> unit_count;
+
+        if ( in.status() != QDataStream::Ok )
+        {
+            return std::auto_ptr<const UnitSystem>();
+        }
+
+        // The scalar dimension and unit are part of every system already.
+        Dimension *dim_p = system_p->GetDimension( name );
+        if ( !dim_p )
+        {
+            if ( system_p->GetDimension( id ) )
+            {
+                return std::auto_ptr<const UnitSystem>();
+            }
+            dim_p = system_p->AddDimension( name, id, packed_id );
+        }
+
+        for ( quint32 j = 0; j < unit_count; ++j )
+        {
+            QString unit_name;
+            QString symbol;
+            in >> unit_name >> symbol;
+            Conversion::AutoPtr to_base_p;
+            Conversion::AutoPtr from_base_p;
+            in >> to_base_p >> from_base_p;
+
+            if ( in.status() != QDataStream::Ok )
+            {
+                return std::auto_ptr<const UnitSystem>();
+            }
+
+            Unit *unit_p = system_p->GetUnit( unit_name );
+            if ( !unit_p )
+            {
+                unit_p = system_p->NewUnit( unit_name, dim_p );
+            }
+            else if ( unit_p->GetDimension() != dim_p )
+            {
+                return std::auto_ptr<const UnitSystem>();
+            }
+
+            unit_p->SetToBase( to_base_p );
+            unit_p->SetFromBase( from_base_p );
+
+            if ( !symbol.isEmpty() && unit_p->Symbol().isEmpty() &&
+                !system_p->SetSymbol( unit_p, symbol ) )
+            {
+                return std::auto_ptr<const UnitSystem>();
+            }
+        }
+
+        if ( base_index >= 0 ) 
+        {
+            if ( base_index >= dim_p->m_units.count() )
+            {
+                return std::auto_ptr<const UnitSystem>();
+            }
+
+            if ( !dim_p->GetBaseUnit() )
+            {
+                dim_p->SetBaseUnit( dim_p->m_units[base_index] );
+            }
+        }
+    }
+
+    quint32 alias_count;
+    in >> alias_count;
+    for ( quint32 i = 0; i < alias_count; ++i )
+    {
+        QString alias;
+        QString name;
+        in >> alias >> name;
+
+        Dimension *dim_p = system_p->GetDimension( name );
+        if ( !dim_p || !system_p->AddAlias( alias, dim_p ) )
+        {
+            return std::auto_ptr<const UnitSystem>();
+        }
+    }
+
+    in >> alias_count;
+    for ( quint32 i = 0; i < alias_count; ++i )
+    {
+        QString alias;
+        QString name;
+        in >> alias >> name;
+
+        Unit *unit_p = system_p->GetUnit( name );
+        if ( !unit_p || !system_p->AddAlias( alias, unit_p ) )
+        {
+            return std::auto_ptr<const UnitSystem>();
+        }
+    }
+
+    if ( in.status() != QDataStream::Ok )
+    {
+        return std::auto_ptr<const UnitSystem>();
+    }
+
+    system_p->Freeze();
+    system_p->m_fingerprint = fingerprint;
+    return std::auto_ptr<const UnitSystem>( system_p.release() );
+}
+
 
 //==============================================================================
 /// Immutable interface.
 //==============================================================================
 
 //==============================================================================
-/// Get the dimensions in the units system.
+/// Get the dimensions in the units system, in the same order as 
+/// DimensionsView(), after those of the base system.
 /// 
 /// \return The dimensions.
 /// 
 QList<const Dimension*> UnitSystem::Dimensions() const
 {
     QList<const Dimension*> result;
+    if ( m_base_p )
+    {
+        result = m_base_p->Dimensions();
+    }
 
-    for ( QHash<QString,Dimension*>::const_iterator it = m_dimensions.begin(); 
-        it != m_dimensions.end(); ++it )
+    for ( int i = 0; i < m_dimension_list.count(); ++i )
     {
-        result << it.value();
+        result << m_dimension_list[i];
     }
 
     return result;
 }
 
 //==============================================================================
-/// Get the units in the units system.
+/// Get the units in the units system, in the same order as UnitsView(), 
+/// after those of the base system.
 /// 
 /// \return The units.
 /// 
 QList<const Unit*> UnitSystem::Units() const
 {
     QList<const Unit*> result;
+    if ( m_base_p )
+    {
+        result = m_base_p->Units();
+    }
 
-    for ( QHash<QString,Unit*>::const_iterator it = m_units.begin(); 
-        it != m_units.end(); ++it )
+    for ( int i = 0; i < m_unit_list.count(); ++i )
     {
-        result << it.value();
+        result << m_unit_list[i];
     }
 
     return result;
 }
 
+//==============================================================================
+/// Get a view of the dimensions in the unit system. The dimensions are in 
+/// the order they were added, or once the system is frozen, sorted by name.
+/// Unlike Dimensions(), this doesn't copy the list.
+/// 
+/// \return The view, which is valid until a dimension is added or the 
+///         system is frozen. For an overlay, it holds only the dimensions
+///         added to the overlay.
+/// 
+UnitSystem::DimensionRange UnitSystem::DimensionsView() const
+{
+    const Dimension * const *dims_pp = m_dimension_list.constData();
+    return DimensionRange( dims_pp, dims_pp + m_dimension_list.count() );
+}
+
+//==============================================================================
+/// Get a view of the units in the unit system. The units are in the order 
+/// they were added, or once the system is frozen, grouped by dimension in
+/// the order of DimensionsView(). Unlike Units(), this doesn't copy the 
+/// list.
+/// 
+/// \return The view, which is valid until a unit is added or the system is
+///         frozen. For an overlay, it holds only the units added to the 
+///         overlay.
+/// 
+UnitSystem::UnitRange UnitSystem::UnitsView() const
+{
+    const Unit * const *units_pp = m_unit_list.constData();
+    return UnitRange( units_pp, units_pp + m_unit_list.count() );
+}
+
 //==============================================================================
 /// Get the dimension with the given identifier.
 /// 
@@ -100,114 +508,137 @@ QList<const Unit*> UnitSystem::Units() const
 ///
 const Dimension *UnitSystem::GetDimension( const DimensionId& id ) const
 {
-    for ( QHash<QString,Dimension*>::const_iterator it = m_dimensions.begin();
-        it != m_dimensions.end(); ++it )
-    {
-        if ( it.value()->Id() == id )
-        {
-            return it.value();
-        }
-    }
-
-    return NULL;
+    return FindDimension( id );
 }
 
 //==============================================================================
-/// Get the dimension with the given name.
+/// Get the dimension with the given packed identifier.
 /// 
-/// \param [in] name The name of the dimension.
+/// \param [in] id The identifier.
 /// 
 /// \return The dimension, or NULL if not present.
-/// 
-const Dimension *UnitSystem::GetDimension( const QString& name ) const
+///
+const Dimension *UnitSystem::GetDimension( const PackedDimensionId& id ) const
 {
-    QHash<QString,Dimension*>::const_iterator it = 
-        m_dimensions.find( NormalizeName( name ) );
-
-    return ( it != m_dimensions.end() ) ? it.value() : NULL;
+    return FindDimension( id );
 }
 
 //==============================================================================
-/// Get the unit with the given name.
+/// Convert a packed dimension identifier back to a string-keyed one, keyed
+/// by the base dimensions' id keys. This is mostly useful for debugging.
 /// 
-/// \param [in] name The name of the dimension.
+/// \param [in] id The packed identifier.
 /// 
-/// \return The unit, or NULL if not present.
+/// \return The identifier.
 /// 
-const Unit *UnitSystem::GetUnit( const QString& name ) const
+DimensionId UnitSystem::Unpack( const PackedDimensionId& id ) const
 {
-    QHash<QString,Unit*>::const_iterator it = 
-        m_units.find( NormalizeName( name ) );
+    DimensionId result;
 
-    return ( it != m_units.end() ) ? it.value() : NULL;
-}
+    for ( int i = 0; i < m_base_keys.count(); ++i )
+    {
+        if ( id.Exponent( i ) != 0 )
+        {
+            result[m_base_keys[i]] = id.Exponent( i );
+        }
+    }
 
-//==============================================================================
-// Mutable interface (used only during parsing).
-//==============================================================================
+    return result;
+}
 
 //==============================================================================
-/// Get the dimensions in the unit system.
+/// Get the dimension of the product of quantities of two dimensions.
 /// 
-/// \return The list of dimensions.
+/// \param [in] lhs_p The left hand side.
+/// \param [in] rhs_p The right hand side.
 /// 
-QList<Dimension*> UnitSystem::Dimensions()
+/// \return The dimension, or NULL if the system has no such dimension.
+/// 
+const Dimension *UnitSystem::Multiply( 
+    const Dimension *lhs_p, const Dimension *rhs_p ) const
 {
-    return m_dimensions.values();
+    return Combine( lhs_p, rhs_p, MultiplyOp );
 }
 
 //==============================================================================
-/// Add a new dimension to the unit system.
+/// Get the dimension of the quotient of quantities of two dimensions.
 /// 
-/// \param [in] name The name of the dimension.
-/// \param [in] id The ID of the dimension.
+/// \param [in] lhs_p The left hand side.
+/// \param [in] rhs_p The right hand side.
 /// 
-/// \return The dimension.
+/// \return The dimension, or NULL if the system has no such dimension.
 /// 
-Dimension *UnitSystem::NewDimension( 
-    const QString& name, const DimensionId& id )
+const Dimension *UnitSystem::Divide( 
+    const Dimension *lhs_p, const Dimension *rhs_p ) const
 {
-    // \todo Throw exception.
-    assert( !GetDimension( name ) );
-    assert( !GetDimension( id ) );
-
-    Dimension *dim_p = new Dimension( name, id );
-
-    m_dimensions.insert( NormalizeName( name ), dim_p );
-
-    return dim_p;
+    return Combine( lhs_p, rhs_p, DivideOp );
 }
 
 //==============================================================================
-/// Get the dimension with the given name.
+/// Get the dimension with the given name or alias.
 /// 
 /// \param [in] name The name of the dimension.
 /// 
 /// \return The dimension, or NULL if not present.
 /// 
-Dimension *UnitSystem::GetDimension( const QString& name )
+const Dimension *UnitSystem::GetDimension( const QString& name ) const
 {
-    QHash<QString,Dimension*>::const_iterator it = 
-        m_dimensions.find( NormalizeName( name ) );
-
-    return ( it != m_dimensions.end() ) ? it.value() : NULL;
+    return FindDimension( FindName( name ) );
 }
 
 //==============================================================================
-/// Get the dimension with the given id.
+/// Get the unit with the given name or alias.
 /// 
-/// \param [in] id The id of the dimension.
+/// \param [in] name The name of the dimension.
 /// 
-/// \return The dimension, or NULL if not present.
+/// \return The unit, or NULL if not present.
 /// 
-Dimension *UnitSystem::GetDimension( const DimensionId& id )
+/// \note Names made of an SI prefix and the name or alias of a unit in the
+///       system, such as "Kilometer" or "Milliamp", are resolved even if they
+///       aren't defined. Prefixed units are not included in Units() or in
+///       their dimension's unit list.
+/// 
+const Unit *UnitSystem::GetUnit( const QString& name ) const
 {
-    for ( QHash<QString,Dimension*>::const_iterator it = m_dimensions.begin(); 
-        it != m_dimensions.end(); ++it )
+    const Atom key( FindName( name ) );
+
+    const Unit *unit_p = FindUnit( key );
+    if ( unit_p )
+    {
+        return unit_p;
+    }
+
+    // Names resolved to prefixed units before are remembered by their atom.
+    if ( key )
+    {
+        unit_p = FindPrefixedName( key );
+        if ( unit_p )
+        {
+            return unit_p;
+        }
+    }
+
+    const UnitSystem *root_p = this;
+    while ( root_p->m_base_p )
+    {
+        root_p = root_p->m_base_p;
+    }
+
+    QString normalized( NormalizeName( name ) );
+    const QChar *begin_p = normalized.constData();
+    const QChar *end_p = begin_p + normalized.count();
+    int lengths[MAX_PREFIX_MATCHES];
+    int prefixes[MAX_PREFIX_MATCHES];
+    int count = root_p->m_prefix_names.FindPrefixes( 
+        begin_p, end_p, lengths, prefixes, MAX_PREFIX_MATCHES );
+
+    for ( int i = count - 1; i >= 0; --i )
     {
-        if ( it.value()->Id() == id )
+        unit_p = FindUnit( AtomTable::Find( normalized.mid( lengths[i] ) ) );
+        if ( unit_p )
         {
-            return it.value();
+            return GetPrefixedUnit( unit_p, prefixes[i], 
+                AtomTable::Intern( normalized ) );
         }
     }
 
@@ -215,54 +646,1132 @@ Dimension *UnitSystem::GetDimension( const DimensionId& id )
 }
 
 //==============================================================================
-/// Get the units in the units system.
+/// Get the unit with the given name or alias, without resolving names made 
+/// of an SI prefix and a unit's name. Unlike GetUnit(), this never changes
+/// the system's caches.
 /// 
-/// \return The units.
+/// \param [in] name The name of the unit.
 /// 
-QList<Unit*> UnitSystem::Units()
+/// \return The unit, or NULL if it isn't defined in the system or its base.
+/// 
+const Unit *UnitSystem::GetDefinedUnit( const QString& name ) const
 {
-    return m_units.values();
+    return FindUnit( FindName( name ) );
 }
 
 //==============================================================================
-/// Add a new unit to the unit system.
+/// Get the unit with the given symbol. Symbols are case sensitive. A symbol
+/// made of an SI prefix symbol and the symbol of a unit in the system, such
+/// as "km" or "mV", resolves to the prefixed unit unless it is the symbol of
+/// a unit itself.
 /// 
-/// \param [in] name The unit name.
-/// \param [in] dim_p The unit dimension.
+/// \param [in] symbol The symbol.
 /// 
-/// \return The new unit.
+/// \return The unit, or NULL if not present.
 /// 
-Unit *UnitSystem::NewUnit( const QString& name, Dimension *dim_p )
+const Unit *UnitSystem::GetUnitBySymbol( const QString& symbol ) const
 {
-    assert( !GetUnit( name ) );
+    const QChar *begin_p = symbol.constData();
+    const QChar *end_p = begin_p + symbol.count();
+
+    const Unit *unit_p = FindSymbol( begin_p, end_p );
+    if ( unit_p )
+    {
+        return unit_p;
+    }
 
-    Unit *unit_p = new Unit( name, dim_p );
+    const UnitSystem *root_p = this;
+    while ( root_p->m_base_p )
+    {
+        root_p = root_p->m_base_p;
+    }
 
-    m_units.insert( NormalizeName( name ), unit_p );
+    int lengths[MAX_PREFIX_MATCHES];
+    int prefixes[MAX_PREFIX_MATCHES];
+    int count = root_p->m_prefix_symbols.FindPrefixes( 
+        begin_p, end_p, lengths, prefixes, MAX_PREFIX_MATCHES );
 
-    return unit_p;
+    // Prefer the longest prefix.
+    for ( int i = count - 1; i >= 0; --i )
+    {
+        unit_p = FindSymbol( begin_p + lengths[i], end_p );
+        if ( unit_p )
+        {
+            return GetPrefixedUnit( unit_p, prefixes[i] );
+        }
+    }
+
+    return NULL;
 }
 
 //==============================================================================
-/// Get the unit with the given name.
+/// Get the units for a column of unit names, as for GetUnit() on each name.
+/// Columns usually hold only a few distinct names, so each distinct name is
+/// resolved once and the rest are found in a dictionary of the names seen so
+/// far. Runs of the same name skip the dictionary.
 /// 
-/// \param [in] name The name of the unit.
+/// \param [in] names The unit names.
 /// 
-/// \return A pointer to the unit, or NULL if not present.
+/// \return The unit for each name, or NULL where a name isn't present.
 /// 
-Unit *UnitSystem::GetUnit( const QString& name )
+QVector<const Unit*> UnitSystem::GetUnits( const QStringList& names ) const
 {
-    QHash<QString,Unit*>::const_iterator it = 
-        m_units.find( NormalizeName( name ) );
+    QVector<const Unit*> result( names.count() );
+    QHash<QString,const Unit*> dictionary;
+    const QString *previous_p = NULL;
+    const Unit *unit_p = NULL;
+
+    for ( int i = 0; i < names.count(); ++i )
+    {
+        const QString& name( names[i] );
+
+        if ( !previous_p || ( name != *previous_p ) )
+        {
+            QHash<QString,const Unit*>::iterator it = dictionary.find( name );
+            if ( it == dictionary.end() )
+            {
+                it = dictionary.insert( name, GetUnit( name ) );
+            }
+
+            unit_p = it.value();
+            previous_p = &name;
+        }
+
+        result[i] = unit_p;
+    }
 
-    return ( it != m_units.end() ) ? it.value() : NULL;
+    return result;
 }
 
 //==============================================================================
-/// Constructor.
+/// Compute a fingerprint of the contents of the unit system. Two systems with
+/// the same dimensions, units and conversions have the same fingerprint, 
+/// regardless of the order in which they were defined. The fingerprint of an
+/// overlay covers its base.
+/// 
+/// \return The fingerprint.
 /// 
-UnitSystem::UnitSystem()
+QByteArray UnitSystem::Fingerprint() const
 {
+    if ( !m_fingerprint.isEmpty() )
+    {
+        return m_fingerprint;
+    }
+
+    QByteArray contents;
+    QDataStream out( &contents, QIODevice::WriteOnly );
+
+    if ( m_base_p )
+    {
+        out << m_base_p->Fingerprint();
+    }
+
+    QVector< QPair<QString,Dimension*> > dims( SortByName( m_dimensions ) );
+
+    for ( int i = 0; i < dims.count(); ++i )
+    {
+        const Dimension *dim_p = dims[i].second;
+
+        QStringList id_terms;
+        DimensionId id( dim_p->Id() );
+        for ( DimensionId::const_iterator it = id.begin(); it != id.end(); 
+            ++it )
+        {
+            if ( it.value() != 0 )
+            {
+                id_terms << it.key() + "^" + QString::number( it.value() );
+            }
+        }
+        id_terms.sort();
+
+        out << dim_p->Name() << id_terms.join( "*" );
+        out << ( dim_p->GetBaseUnit() ? 
+            dim_p->GetBaseUnit()->Name() : QString() );
+    }
+
+    QVector< QPair<QString,Unit*> > units( SortByName( m_units ) );
+
+    for ( int i = 0; i < units.count(); ++i )
+    {
+        const Unit *unit_p = units[i].second;
+
+        out << unit_p->Name() << unit_p->Symbol(); 
+        out << unit_p->GetDimension()->Name();
+        out << *unit_p->ToBase() << *unit_p->FromBase();
+    }
+
+    return QCryptographicHash::hash( contents, QCryptographicHash::Sha1 );
+}
+
+//==============================================================================
+/// Get the version of the unit system. This changes whenever a dimension, 
+/// unit or symbol is added, so results that depend on which names the system
+/// defines can be recognized as stale. Changes to the units of a dimension 
+/// are tracked by Dimension::Version().
+/// 
+/// \return The version.
+/// 
+quint32 UnitSystem::Version() const
+{
+    return m_base_p ? m_base_p->Version() + m_version : m_version;
+}
+
+//==============================================================================
+/// Get the system this is an overlay of.
+/// 
+/// \return The base system, or NULL if this isn't an overlay.
+/// 
+const UnitSystem *UnitSystem::Base() const
+{
+    return m_base_p;
+}
+
+//==============================================================================
+/// Save the unit system to a snapshot that Load() can rebuild it from. The
+/// snapshot is versioned and holds a checksum of its contents, so stale or
+/// damaged snapshots are rejected when loaded. It also holds the fingerprint
+/// of the system, so a loaded system needn't compute it.
+/// 
+/// \param [in] path The path of the file to write.
+/// 
+/// \return True if the file was written. Overlays can't be saved, since a 
+///         snapshot can't refer to another system.
+/// 
+bool UnitSystem::Save( const QString& path ) const
+{
+    if ( m_base_p )
+    {
+        return false;
+    }
+
+    QByteArray contents;
+    QDataStream out( &contents, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+
+    // The checksum is filled in once the rest is written.
+    out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION;
+    const qint64 checksum_offset = out.device()->pos();
+    out << Checksum( QByteArray(), 0 );
+    const int body_offset = int( out.device()->pos() );
+
+    out << Fingerprint() << m_base_keys;
+
+    QVector< QPair<QString,Dimension*> > dims( SortByName( m_dimensions ) );
+    out << quint32( dims.count() );
+
+    for ( int i = 0; i < dims.count(); ++i )
+    {
+        const Dimension *dim_p = dims[i].second;
+
+        DimensionId id( dim_p->Id() );
+        QStringList terms;
+        for ( DimensionId::const_iterator it = id.begin(); it != id.end(); 
+            ++it )
+        {
+            if ( it.value() != 0 )
+            {
+                terms << it.key();
+            }
+        }
+        terms.sort();
+
+        out << dim_p->Name() << quint32( terms.count() );
+        for ( int j = 0; j < terms.count(); ++j )
+        {
+            out << terms[j] << qint32( id.value( terms[j] ) );
+        }
+
+        PackedDimensionId packed_id( dim_p->PackedId() );
+        for ( int j = 0; j < PackedDimensionId::MAX_BASES; ++j )
+        {
+            out << qint8( packed_id.Exponent( j ) );
+        }
+
+        const Unit *base_p = dim_p->GetBaseUnit();
+        Dimension::UnitRange units( dim_p->UnitsView() );
+        out << qint32( base_p ? base_p->Index() : -1 ) 
+            << quint32( units.count() );
+
+        for ( int j = 0; j < units.count(); ++j )
+        {
+            out << units[j]->Name() << units[j]->Symbol() 
+                << *units[j]->ToBase() << *units[j]->FromBase();
+        }
+    }
+
+    QVector< QPair<QString,const Dimension*> > dim_aliases( 
+        SortByName( m_dimension_aliases ) );
+    out << quint32( dim_aliases.count() );
+    for ( int i = 0; i < dim_aliases.count(); ++i )
+    {
+        out << dim_aliases[i].first << dim_aliases[i].second->Name();
+    }
+
+    QVector< QPair<QString,const Unit*> > unit_aliases( 
+        SortByName( m_unit_aliases ) );
+    out << quint32( unit_aliases.count() );
+    for ( int i = 0; i < unit_aliases.count(); ++i )
+    {
+        out << unit_aliases[i].first << unit_aliases[i].second->Name();
+    }
+
+    out.device()->seek( checksum_offset );
+    out << Checksum( contents, body_offset );
+
+    return Util::ReplaceFile( path, contents );
+}
+
+//==============================================================================
+/// Get a prefixed unit, creating it the first time it is looked up. This may
+/// be called from several threads at once.
+/// 
+/// \param [in] unit_p The unit to prefix.
+/// \param [in] prefix The index of the prefix.
+/// \param [in] name_atom The atom for the normalized name the unit was 
+///        looked up by, so the name resolves directly next time, or zero.
+/// 
+/// \return The prefixed unit.
+/// 
+const Unit *UnitSystem::GetPrefixedUnit( const Unit *unit_p, int prefix, 
+    Atom name_atom ) const
+{
+    QMutexLocker locker( &m_prefixed_mutex );
+
+    PrefixedKey key( unit_p, prefix );
+    PrefixedEntry *entry_p = m_prefixed_units.value( key, NULL );
+    if ( !entry_p )
+    {
+        entry_p = new PrefixedEntry;
+        entry_p->unit_p = unit_p;
+        entry_p->prefix = prefix;
+        entry_p->prefixed_p = NULL;
+        entry_p->version = 0;
+        m_prefixed_units.insert( key, entry_p );
+    }
+
+    if ( name_atom )
+    {
+        m_prefixed_names.insert( name_atom, entry_p );
+    }
+
+    return CurrentPrefixedUnit( entry_p );
+}
+
+//==============================================================================
+/// Get the prefixed unit for a name that resolved to one before.
+/// 
+/// \param [in] key The atom for the normalized name.
+/// 
+/// \return The prefixed unit, or NULL if the name hasn't been resolved to a
+///         prefixed unit.
+/// 
+const Unit *UnitSystem::FindPrefixedName( Atom key ) const
+{
+    QMutexLocker locker( &m_prefixed_mutex );
+
+    PrefixedEntry *entry_p = m_prefixed_names.value( key, NULL );
+    return entry_p ? CurrentPrefixedUnit( entry_p ) : NULL;
+}
+
+//==============================================================================
+/// Get the prefixed unit of a cache entry, building it if the unit has been
+/// redefined since. m_prefixed_mutex must be held.
+/// 
+/// \param [in] entry_p The entry.
+/// 
+/// \return The prefixed unit.
+/// 
+const Unit *UnitSystem::CurrentPrefixedUnit( PrefixedEntry *entry_p ) const
+{
+    const Unit *unit_p = entry_p->unit_p;
+    const quint32 version = unit_p->GetDimension()->Version();
+
+    if ( entry_p->prefixed_p && ( entry_p->version == version ) )
+    {
+        return entry_p->prefixed_p;
+    }
+
+    // The dimension changed since the conversions were built, so the unit
+    // may have been redefined. Build a new prefixed unit rather than change
+    // one that readers may be using; the old one stays in the arena.
+    const Prefix& prefix( PREFIXES[entry_p->prefix] );
+    QString unit_name( unit_p->Name() );
+    Unit *prefixed_p = 
+        new ( m_prefixed_arena.Allocate( sizeof( Unit ) ) ) Unit( 
+            prefix.name + unit_name.left( 1 ).toLower() + unit_name.mid( 1 ), 
+            *unit_p, std::pow( 10.0, prefix.exponent ), &m_prefixed_arena );
+
+    if ( unit_p->m_symbol_atom )
+    {
+        prefixed_p->m_symbol_atom = 
+            AtomTable::Intern( prefix.symbol + unit_p->Symbol() );
+    }
+
+    entry_p->prefixed_p = prefixed_p;
+    entry_p->version = version;
+    return prefixed_p;
+}
+
+//==============================================================================
+// Mutable interface.
+//==============================================================================
+
+//==============================================================================
+/// Get the dimensions in the unit system. For an overlay, this is only the
+/// dimensions added to the overlay.
+/// 
+/// \return The list of dimensions.
+/// 
+QList<Dimension*> UnitSystem::Dimensions()
+{
+    return m_dimension_list.toList();
+}
+
+//==============================================================================
+/// Add a new dimension to the unit system.
+/// 
+/// \param [in] name The name of the dimension.
+/// \param [in] id The ID of the dimension.
+/// 
+/// \return The dimension, or NULL if the id needs more base dimensions than
+///         a packed id can hold. The system is unchanged in that case.
+/// 
+Dimension *UnitSystem::NewDimension( 
+    const QString& name, const DimensionId& id )
+{
+    // \todo Throw exception.
+    assert( !FindDimension( FindName( name ) ) );
+    assert( !FindDimension( id ) );
+
+    PackedDimensionId packed_id;
+    if ( !Pack( id, &packed_id ) )
+    {
+        return NULL;
+    }
+
+    // Algebra results that weren't in the system may be now.
+    ClearAlgebraCache();
+
+    return AddDimension( name, id, packed_id );
+}
+
+//==============================================================================
+/// Add a new dimension with an already packed id to the unit system.
+/// 
+/// \param [in] name The name of the dimension.
+/// \param [in] id The ID of the dimension.
+/// \param [in] packed_id The packed ID of the dimension.
+/// 
+/// \return The dimension.
+/// 
+Dimension *UnitSystem::AddDimension( const QString& name, 
+    const DimensionId& id, const PackedDimensionId& packed_id )
+{
+    Dimension *dim_p = new ( m_arena.Allocate( sizeof( Dimension ) ) ) 
+        Dimension( name, id, packed_id );
+    ++m_version;
+
+    m_dimensions.insert( dim_p->NameAtom(), dim_p );
+    m_dimension_list.append( dim_p );
+    m_dimension_ids.insert( id, dim_p );
+
+    // Derivations that aren't in terms of base dimensions may reduce to the
+    // same packed id; the first such dimension wins.
+    if ( !m_packed_ids.contains( packed_id ) )
+    {
+        m_packed_ids.insert( packed_id, dim_p );
+    }
+
+    return dim_p;
+}
+
+//==============================================================================
+/// Get the dimension with the given name or alias.
+/// 
+/// \param [in] name The name of the dimension.
+/// 
+/// \return The dimension, or NULL if not present. For an overlay, this is 
+///         also NULL for a dimension of the base system, which can only be
+///         looked up through the immutable interface.
+/// 
+Dimension *UnitSystem::GetDimension( const QString& name )
+{
+    return OwnDimension( FindDimension( FindName( name ) ) );
+}
+
+//==============================================================================
+/// Get the dimension with the given id.
+/// 
+/// \param [in] id The id of the dimension.
+/// 
+/// \return The dimension, or NULL if not present. For an overlay, this is 
+///         also NULL for a dimension of the base system.
+/// 
+Dimension *UnitSystem::GetDimension( const DimensionId& id )
+{
+    return OwnDimension( FindDimension( id ) );
+}
+
+//==============================================================================
+/// Get the units in the units system. For an overlay, this is only the units
+/// added to the overlay.
+/// 
+/// \return The units.
+/// 
+QList<Unit*> UnitSystem::Units()
+{
+    return m_unit_list.toList();
+}
+
+//==============================================================================
+/// Add a new unit to the unit system.
+/// 
+/// \param [in] name The unit name.
+/// \param [in] dim_p The unit dimension. For an overlay, this may be a 
+///        dimension of the base system.
+/// 
+/// \return The new unit.
+/// 
+/// \note A unit added to an overlay in a dimension of the base system isn't
+///       added to the dimension's unit list, so its index is -1, and 
+///       redefining it doesn't change the dimension's version. Such units 
+///       should be fully defined before conversions to them are looked up.
+/// 
+Unit *UnitSystem::NewUnit( const QString& name, const Dimension *dim_p )
+{
+    assert( !FindUnit( FindName( name ) ) );
+
+    Dimension *own_dim_p = OwnDimension( dim_p );
+    Unit *unit_p = new ( m_arena.Allocate( sizeof( Unit ) ) ) Unit( name, 
+        dim_p, own_dim_p ? own_dim_p->UnitCount() : -1, &m_arena );
+
+    if ( own_dim_p )
+    {
+        own_dim_p->AddUnit( unit_p );
+    }
+
+    m_units.insert( unit_p->NameAtom(), unit_p );
+    m_unit_list.append( unit_p );
+    ++m_version;
+
+    return unit_p;
+}
+
+//==============================================================================
+/// Add many new units of one dimension to the unit system, as for NewUnit()
+/// on each name. Space for the units is reserved up front.
+/// 
+/// \param [in] names The unit names. None may be defined already.
+/// \param [in] dim_p The dimension of the units.
+/// 
+/// \return The new units, in the order of their names.
+/// 
+QVector<Unit*> UnitSystem::NewUnits( const QStringList& names, 
+    const Dimension *dim_p )
+{
+    Reserve( m_dimension_list.count(), m_unit_list.count() + names.count() );
+
+    Dimension *own_dim_p = OwnDimension( dim_p );
+    if ( own_dim_p )
+    {
+        own_dim_p->Reserve( own_dim_p->UnitCount() + names.count() );
+    }
+
+    QVector<Unit*> result( names.count() );
+    for ( int i = 0; i < names.count(); ++i )
+    {
+        result[i] = NewUnit( names[i], dim_p );
+    }
+
+    return result;
+}
+
+//==============================================================================
+/// Reserve space for dimensions and units about to be added, so that 
+/// building a very large system doesn't repeatedly grow its indexes, and the
+/// new objects are allocated from one stretch of the system's arena.
+/// 
+/// \param [in] dimension_count The total number of dimensions the system 
+///        will hold.
+/// \param [in] unit_count The total number of units the system will hold.
+/// 
+void UnitSystem::Reserve( int dimension_count, int unit_count )
+{
+    m_dimensions.reserve( dimension_count );
+    m_dimension_list.reserve( dimension_count );
+    m_dimension_ids.reserve( dimension_count );
+    m_packed_ids.reserve( dimension_count );
+    m_units.reserve( unit_count );
+    m_unit_list.reserve( unit_count );
+
+    // Reserve one stretch for both kinds of object and the conversions a 
+    // new unit starts with. Reserving them separately could leave the end 
+    // of a chunk unused between them.
+    m_arena.Reserve( 
+        Util::Arena::Aligned( sizeof( Dimension ) ) * 
+            qMax( 0, dimension_count - m_dimension_list.count() ) +
+        ( Util::Arena::Aligned( sizeof( Unit ) ) + 
+            2 * Util::Arena::Aligned( sizeof( Conversions::Value ) ) ) * 
+            qMax( 0, unit_count - m_unit_list.count() ) );
+}
+
+//==============================================================================
+/// Get the unit with the given name or alias.
+/// 
+/// \param [in] name The name of the unit.
+/// 
+/// \return A pointer to the unit, or NULL if not present. For an overlay, 
+///         this is also NULL for a unit of the base system, which can only
+///         be looked up through the immutable interface.
+/// 
+Unit *UnitSystem::GetUnit( const QString& name )
+{
+    return OwnUnit( FindUnit( FindName( name ) ) );
+}
+
+//==============================================================================
+/// Set the symbol of a unit.
+/// 
+/// \param [in] unit_p The unit. This must not already have a symbol.
+/// \param [in] symbol The symbol.
+/// 
+/// \return True if the symbol was set, false if another unit already has 
+///         the symbol.
+/// 
+bool UnitSystem::SetSymbol( Unit *unit_p, const QString& symbol )
+{
+    assert( unit_p->Symbol().isEmpty() );
+
+    if ( ( m_base_p && 
+            m_base_p->FindSymbol( symbol.constData(), 
+                symbol.constData() + symbol.count() ) ) ||
+        !m_symbols.Insert( symbol, m_symbol_units.count() ) )
+    {
+        return false;
+    }
+
+    unit_p->m_symbol_atom = AtomTable::Intern( symbol );
+    m_symbol_units.append( unit_p );
+    ++m_version;
+    return true;
+}
+
+//==============================================================================
+/// Add another name for a dimension. The alias resolves directly to the 
+/// dimension, and isn't listed separately by Dimensions().
+/// 
+/// \param [in] alias The alias.
+/// \param [in] dim_p The dimension.
+/// 
+/// \return True if the alias was added, false if it is already the name or
+///         alias of a dimension.
+/// 
+bool UnitSystem::AddAlias( const QString& alias, const Dimension *dim_p )
+{
+    Atom key( InternName( alias ) );
+    if ( FindDimension( key ) )
+    {
+        return false;
+    }
+
+    m_dimension_aliases.insert( key, dim_p );
+    ++m_version;
+    return true;
+}
+
+//==============================================================================
+/// Add another name for a unit. The alias resolves directly to the unit, and
+/// isn't listed separately by Units().
+/// 
+/// \param [in] alias The alias.
+/// \param [in] unit_p The unit.
+/// 
+/// \return True if the alias was added, false if it is already the name or
+///         alias of a unit.
+/// 
+bool UnitSystem::AddAlias( const QString& alias, const Unit *unit_p )
+{
+    Atom key( InternName( alias ) );
+    if ( FindUnit( key ) )
+    {
+        return false;
+    }
+
+    m_unit_aliases.insert( key, unit_p );
+    ++m_version;
+    return true;
+}
+
+//==============================================================================
+/// Get the result of a dimension algebra operation. Results are cached in a
+/// direct-mapped table, so a repeated operation costs one probe. Neither
+/// lookups nor misses lock or allocate, so this may be called from several 
+/// threads at once.
+/// 
+/// \param [in] lhs_p The left hand side.
+/// \param [in] rhs_p The right hand side.
+/// \param [in] op The operation.
+/// 
+/// \return The dimension, or NULL if the system has no such dimension.
+/// 
+const Dimension *UnitSystem::Combine( const Dimension *lhs_p, 
+    const Dimension *rhs_p, AlgebraOp op ) const
+{
+    assert( lhs_p && rhs_p );
+
+    uint hash = ( ::qHash( quintptr( lhs_p ) ) * 31u + 
+        ::qHash( quintptr( rhs_p ) ) ) * 2u + uint( op );
+    hash = ( hash * 2654435761u ) >> ( 32 - ALGEBRA_CACHE_BITS );
+    AlgebraEntry& entry( m_algebra_cache[hash] );
+
+    // The fields are only trusted if the sequence was even before they were
+    // read and unchanged after, so no write overlapped the read.
+    const int sequence = entry.sequence.fetchAndAddAcquire( 0 );
+    if ( !( sequence & 1 ) && ( entry.lhs_p == lhs_p ) && 
+        ( entry.rhs_p == rhs_p ) && ( entry.op == op ) )
+    {
+        const Dimension *result_p = entry.result_p;
+        if ( entry.sequence.fetchAndAddOrdered( 0 ) == sequence )
+        {
+            return result_p;
+        }
+    }
+
+    const Dimension *result_p = GetDimension( ( op == MultiplyOp ) ? 
+        lhs_p->PackedId() * rhs_p->PackedId() : 
+        lhs_p->PackedId() / rhs_p->PackedId() );
+
+    // Overwrite the entry in place. If another thread got to it first, its
+    // result is cached instead.
+    if ( !( sequence & 1 ) && 
+        entry.sequence.testAndSetAcquire( sequence, sequence + 1 ) )
+    {
+        entry.lhs_p = lhs_p;
+        entry.rhs_p = rhs_p;
+        entry.op = op;
+        entry.result_p = result_p;
+        entry.sequence.fetchAndStoreRelease( 
+            int( ( uint( sequence ) + 2u ) & 0x7fffffffu ) );
+    }
+
+    return result_p;
+}
+
+//==============================================================================
+/// Find a dimension by name or alias, falling through to the base system.
+/// 
+/// \param [in] key The atom for the normalized name or alias.
+/// 
+/// \return The dimension, or NULL if not present.
+/// 
+const Dimension *UnitSystem::FindDimension( Atom key ) const
+{
+    QHash<Atom,Dimension*>::const_iterator it = m_dimensions.find( key );
+    if ( it != m_dimensions.end() )
+    {
+        return it.value();
+    }
+
+    QHash<Atom,const Dimension*>::const_iterator alias_it = 
+        m_dimension_aliases.find( key );
+    if ( alias_it != m_dimension_aliases.end() )
+    {
+        return alias_it.value();
+    }
+
+    return m_base_p ? m_base_p->FindDimension( key ) : NULL;
+}
+
+//==============================================================================
+/// Find a dimension by id, falling through to the base system.
+/// 
+/// \param [in] id The id.
+/// 
+/// \return The dimension, or NULL if not present.
+/// 
+const Dimension *UnitSystem::FindDimension( const DimensionId& id ) const
+{
+    const Dimension *dim_p = m_dimension_ids.value( id, NULL );
+    if ( !dim_p && m_base_p )
+    {
+        dim_p = m_base_p->FindDimension( id );
+    }
+
+    return dim_p;
+}
+
+//==============================================================================
+/// Find a dimension by packed id, falling through to the base system.
+/// 
+/// \param [in] id The packed id.
+/// 
+/// \return The dimension, or NULL if not present.
+/// 
+const Dimension *UnitSystem::FindDimension( const PackedDimensionId& id ) 
+    const
+{
+    const Dimension *dim_p = m_packed_ids.value( id, NULL );
+    if ( !dim_p && m_base_p )
+    {
+        dim_p = m_base_p->FindDimension( id );
+    }
+
+    return dim_p;
+}
+
+//==============================================================================
+/// Find a unit by name or alias, falling through to the base system.
+/// 
+/// \param [in] key The atom for the normalized name or alias.
+/// 
+/// \return The unit, or NULL if not present.
+/// 
+const Unit *UnitSystem::FindUnit( Atom key ) const
+{
+    QHash<Atom,Unit*>::const_iterator it = m_units.find( key );
+    if ( it != m_units.end() )
+    {
+        return it.value();
+    }
+
+    QHash<Atom,const Unit*>::const_iterator alias_it = 
+        m_unit_aliases.find( key );
+    if ( alias_it != m_unit_aliases.end() )
+    {
+        return alias_it.value();
+    }
+
+    return m_base_p ? m_base_p->FindUnit( key ) : NULL;
+}
+
+//==============================================================================
+/// Get a writable pointer to a dimension found in the system.
+/// 
+/// \param [in] dim_p The dimension, or NULL.
+/// 
+/// \return The dimension, or NULL if it is NULL or belongs to the base 
+///         system rather than this one.
+/// 
+Dimension *UnitSystem::OwnDimension( const Dimension *dim_p ) const
+{
+    Dimension *own_p = 
+        dim_p ? m_dimension_ids.value( dim_p->Id(), NULL ) : NULL;
+    return ( own_p == dim_p ) ? own_p : NULL;
+}
+
+//==============================================================================
+/// Get a writable pointer to a unit found in the system.
+/// 
+/// \param [in] unit_p The unit, or NULL.
+/// 
+/// \return The unit, or NULL if it is NULL or belongs to the base system 
+///         rather than this one.
+/// 
+Unit *UnitSystem::OwnUnit( const Unit *unit_p ) const
+{
+    Unit *own_p = unit_p ? m_units.value( unit_p->NameAtom(), NULL ) : NULL;
+    return ( own_p == unit_p ) ? own_p : NULL;
+}
+
+//==============================================================================
+/// Find a unit by its exact symbol, falling through to the base system. 
+/// Unlike GetUnitBySymbol(), this doesn't resolve prefixed symbols, so it 
+/// never changes the base system's caches.
+/// 
+/// \param [in] begin_p The start of the symbol.
+/// \param [in] end_p The end of the symbol.
+/// 
+/// \return The unit, or NULL if not present.
+/// 
+const Unit *UnitSystem::FindSymbol( const QChar *begin_p, 
+    const QChar *end_p ) const
+{
+    int index = m_symbols.Find( begin_p, end_p );
+    if ( index >= 0 )
+    {
+        return m_symbol_units[index];
+    }
+
+    return m_base_p ? m_base_p->FindSymbol( begin_p, end_p ) : NULL;
+}
+
+//==============================================================================
+/// Convert a dimension identifier to a packed one. Keys that name a unit in 
+/// the system stand for that unit's dimension; any other key is the key of a
+/// base dimension, and is assigned the next base dimension index the first
+/// time it is seen.
+/// 
+/// \param [in] id The identifier.
+/// \param [out] packed_id_p The packed identifier.
+/// 
+/// \return True if the identifier was packed, false if it would take the 
+///         system past PackedDimensionId::MAX_BASES base dimensions. No 
+///         base dimensions are added in that case.
+/// 
+bool UnitSystem::Pack( const DimensionId& id, PackedDimensionId *packed_id_p )
+{
+    PackedDimensionId result;
+    QHash<QString,int> new_indices;
+    QStringList new_keys;
+
+    for ( DimensionId::const_iterator it = id.begin(); it != id.end(); ++it )
+    {
+        if ( it.value() == 0 )
+        {
+            continue;
+        }
+
+        QString key( NormalizeName( it.key() ) );
+        int index = 
+            m_base_indices.value( key, new_indices.value( key, -1 ) );
+
+        if ( index >= 0 )
+        {
+            result = result * 
+                ( PackedDimensionId::Base( index ) ^ it.value() );
+            continue;
+        }
+
+        const Unit *unit_p = FindUnit( FindName( it.key() ) );
+        if ( unit_p )
+        {
+            result = result * 
+                ( unit_p->GetDimension()->PackedId() ^ it.value() );
+            continue;
+        }
+
+        index = m_base_keys.count() + new_keys.count();
+        if ( index >= PackedDimensionId::MAX_BASES )
+        {
+            return false;
+        }
+
+        new_indices.insert( key, index );
+        new_keys.append( it.key() );
+        result = result * ( PackedDimensionId::Base( index ) ^ it.value() );
+    }
+
+    // Overlays of a frozen system have copied its base dimension indices.
+    assert( new_keys.isEmpty() || !m_frozen );
+
+    m_base_indices.unite( new_indices );
+    m_base_keys += new_keys;
+    *packed_id_p = result;
+    return true;
+}
+
+//==============================================================================
+/// Compact the system for fast read-only use. The dimensions are moved into
+/// one contiguous array, sorted by name, and the units into another, grouped 
+/// by dimension in the order they were added, with their conversions after
+/// them in the same arena. Names and symbols are atoms, so the objects and 
+/// the indexes need no strings of their own.
+/// 
+/// \note This moves every dimension and unit, so it must be called before
+///       any pointers to them or copies of their names are handed out. It is
+///       called by the definition parser when parsing succeeds. For an 
+///       overlay, whose units may be in the base system's dimensions, it 
+///       only marks the overlay frozen, so it can be the base of other 
+///       overlays.
+///
+/// \note A frozen system must not get new base dimensions, since overlays 
+///       of it share its base dimension indices.
+/// 
+void UnitSystem::Freeze()
+{
+    m_frozen = true;
+
+    if ( m_base_p )
+    {
+        return;
+    }
+
+    // Prefixed units and algebra results refer to the objects being moved.
+    ClearCaches();
+
+    QVector< QPair<QString,Dimension*> > dims( SortByName( m_dimensions ) );
+
+    // Placement-construct the new objects in contiguous arrays in a new 
+    // arena.
+    const int dim_count = m_dimensions.count();
+    const int unit_count = m_units.count();
+
+    Util::Arena arena;
+    Dimension *dims_p = static_cast<Dimension*>( 
+        arena.Allocate( dim_count * sizeof( Dimension ) ) );
+    Unit *units_p = static_cast<Unit*>( 
+        arena.Allocate( unit_count * sizeof( Unit ) ) );
+
+    QHash<const Dimension*,Dimension*> dim_map;
+    QHash<const Unit*,Unit*> unit_map;
+    QHash<Atom,Dimension*> dimensions;
+    QHash<Atom,Unit*> units;
+    dim_map.reserve( dim_count );
+    unit_map.reserve( unit_count );
+    dimensions.reserve( dim_count );
+    units.reserve( unit_count );
+    int unit_index = 0;
+
+    for ( int i = 0; i < dims.count(); ++i )
+    {
+        Dimension *old_dim_p = dims[i].second;
+        Dimension *dim_p = new ( dims_p + i ) Dimension( *old_dim_p );
+        dim_map.insert( old_dim_p, dim_p );
+
+        dimensions.insert( dim_p->NameAtom(), dim_p );
+
+        dim_p->m_units.clear();
+        dim_p->m_base_unit_p = NULL;
+
+        for ( int j = 0; j < old_dim_p->m_units.count(); ++j )
+        {
+            Unit *old_unit_p = old_dim_p->m_units[j];
+
+            // The old conversions are released with the old arena, so copy
+            // them into the new one.
+            Unit *unit_p = new ( units_p + unit_index++ ) Unit( *old_unit_p );
+            unit_map.insert( old_unit_p, unit_p );
+            unit_p->m_dim_p = dim_p;
+            unit_p->m_arena_p = &m_arena;
+            unit_p->m_to_base_p = 
+                Conversions::CopyToArena( *old_unit_p->ToBase(), &arena );
+            unit_p->m_from_base_p = 
+                Conversions::CopyToArena( *old_unit_p->FromBase(), &arena );
+            dim_p->m_units.append( unit_p );
+
+            if ( old_unit_p == old_dim_p->m_base_unit_p )
+            {
+                dim_p->m_base_unit_p = unit_p;
+            }
+
+            units.insert( unit_p->NameAtom(), unit_p );
+        }
+    }
+
+    assert( unit_index == unit_count );
+
+    // Point the indexes at the new objects.
+    for ( QHash<DimensionId,Dimension*>::iterator it = 
+        m_dimension_ids.begin(); it != m_dimension_ids.end(); ++it )
+    {
+        it.value() = dim_map.value( it.value() );
+    }
+
+    for ( QHash<PackedDimensionId,Dimension*>::iterator it = 
+        m_packed_ids.begin(); it != m_packed_ids.end(); ++it )
+    {
+        it.value() = dim_map.value( it.value() );
+    }
+
+    for ( int i = 0; i < m_symbol_units.count(); ++i )
+    {
+        m_symbol_units[i] = unit_map.value( m_symbol_units[i] );
+    }
+
+    for ( QHash<Atom,const Dimension*>::iterator it = 
+        m_dimension_aliases.begin(); it != m_dimension_aliases.end(); ++it )
+    {
+        it.value() = dim_map.value( it.value() );
+    }
+
+    for ( QHash<Atom,const Unit*>::iterator it = m_unit_aliases.begin(); 
+        it != m_unit_aliases.end(); ++it )
+    {
+        it.value() = unit_map.value( it.value() );
+    }
+
+    // Destroy the old objects, then switch to the new ones. The old arena is
+    // released in one go when the local one goes out of scope.
+    DestroyObjects();
+    m_arena.Swap( arena );
+
+    m_dimensions = dimensions;
+    m_units = units;
+
+    m_dimension_list.resize( dim_count );
+    for ( int i = 0; i < dim_count; ++i )
+    {
+        m_dimension_list[i] = dims_p + i;
+    }
+
+    m_unit_list.resize( unit_count );
+    for ( int i = 0; i < unit_count; ++i )
+    {
+        m_unit_list[i] = units_p + i;
+    }
+}
+
+//==============================================================================
+/// Discard the prefixed units and dimension algebra results built so far.
+/// 
+void UnitSystem::ClearCaches()
+{
+    qDeleteAll( m_prefixed_units );
+    m_prefixed_units.clear();
+    m_prefixed_names.clear();
+
+    // The prefixed units are released with their arena.
+    Util::Arena prefixed_arena;
+    m_prefixed_arena.Swap( prefixed_arena );
+
+    ClearAlgebraCache();
+}
+
+//==============================================================================
+/// Empty the dimension algebra cache. The system is being changed, so no
+/// other thread is using it.
+/// 
+void UnitSystem::ClearAlgebraCache()
+{
+    for ( int i = 0; i < ( 1 << ALGEBRA_CACHE_BITS ); ++i )
+    {
+        m_algebra_cache[i].lhs_p = NULL;
+    }
+}
+
+//==============================================================================
+/// Destroy the dimensions in the arena. The units and conversions hold 
+/// nothing that needs destroying, so they are left as they are. All of their
+/// memory is released with the arena.
+/// 
+void UnitSystem::DestroyObjects()
+{
+    for ( int i = 0; i < m_dimension_list.count(); ++i )
+    {
+        m_dimension_list[i]->~Dimension();
+    }
+}
+
+//==============================================================================
+/// Constructor.
+/// 
+/// \param [in] base_p The system this is an overlay of, or NULL.
+/// 
+UnitSystem::UnitSystem( const UnitSystem *base_p ) : 
+    m_base_p( base_p ), m_frozen( false ), m_version( 0 )
+{
+    if ( m_base_p )
+    {
+        // Keep the base's base dimension indices, so packed ids mean the same
+        // thing in both systems.
+        m_base_indices = m_base_p->m_base_indices;
+        m_base_keys = m_base_p->m_base_keys;
+        return;
+    }
+
+    for ( int i = 0; i < PREFIX_COUNT; ++i )
+    {
+        m_prefix_names.Insert( NormalizeName( PREFIXES[i].name ), i );
+        m_prefix_symbols.Insert( PREFIXES[i].symbol, i );
+
+        // Accept the micro sign and the Greek mu as well as 'u'.
+        if ( PREFIXES[i].exponent == -6 )
+        {
+            m_prefix_symbols.Insert( QString( QChar( 0x00B5 ) ), i );
+            m_prefix_symbols.Insert( QString( QChar( 0x03BC ) ), i );
+        }
+    }
+
     Dimension *scalar_dim_p = NewDimension( "Scalar", DimensionId() );
     NewUnit( "Scalar", scalar_dim_p );
 }
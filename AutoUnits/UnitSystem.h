@@ -8,10 +8,21 @@
 //==============================================================================
 
 #include <memory>
+#include <QAtomicInt>
+#include <QByteArray>
 #include <QHash>
+#include <QMutex>
+#include <QPair>
 #include <QString>
+#include <QStringList>
+#include <QVector>
 
 #include "Types/DimensionId.h"
+#include "Types/PackedDimensionId.h"
+#include "Util/Arena.h"
+#include "Util/AtomTable.h"
+#include "Util/Range.h"
+#include "Util/SymbolTrie.h"
 
 namespace AutoUnits
 {
@@ -21,24 +32,52 @@ class Dimension;
 
 //==============================================================================
 /// An object that defines a unit system.
-/// 
+///
+/// A system may be an overlay of another, in which case it holds only the
+/// dimensions, units, symbols and aliases added to it, and every lookup
+/// falls through to the base system. Any number of overlays can share one
+/// base.
+///
 class UnitSystem
 {
 public:
+    /// A view of the dimensions of a system.
+    typedef Util::Range<const Dimension*> DimensionRange;
+    /// A view of the units of a system.
+    typedef Util::Range<const Unit*> UnitRange;
+
     ~UnitSystem();
     static std::auto_ptr<UnitSystem> Create();
+    static std::auto_ptr<UnitSystem> CreateOverlay( const UnitSystem *base_p );
+    static std::auto_ptr<const UnitSystem> Load( const QString& path );
 
     //==========================================================================
     /// Immutable interface.
     //==========================================================================
     QList<const Dimension*> Dimensions() const;
     QList<const Unit*> Units() const;
+    DimensionRange DimensionsView() const;
+    UnitRange UnitsView() const;
     const Dimension* GetDimension( const DimensionId& id ) const;
     const Dimension *GetDimension( const QString& name ) const;
+    const Dimension *GetDimension( const PackedDimensionId& id ) const;
+    DimensionId Unpack( const PackedDimensionId& id ) const;
+    const Dimension *Multiply( const Dimension *lhs_p, const Dimension *rhs_p )
+        const;
+    const Dimension *Divide( const Dimension *lhs_p, const Dimension *rhs_p )
+        const;
     const Unit *GetUnit( const QString& name ) const;
+    const Unit *GetDefinedUnit( const QString& name ) const;
+    const Unit *GetUnitBySymbol( const QString& symbol ) const;
+    QVector<const Unit*> GetUnits( const QStringList& names ) const;
+    QByteArray Fingerprint() const;
+    quint32 Version() const;
+    const UnitSystem *Base() const;
+    bool Save( const QString& path ) const;
 
     //==========================================================================
-    // Mutable interface (used only during parsing).
+    // Mutable interface. Units may be added or redefined after the system is 
+    // built; see Version() and Dimension::Version().
     //==========================================================================
     QList<Dimension*> Dimensions();
     Dimension *NewDimension( const QString& name, const DimensionId& id );
@@ -46,17 +85,167 @@ public:
     Dimension* GetDimension( const DimensionId& id );
 
     QList<Unit*> Units();
-    Unit *NewUnit( const QString& name, Dimension *dim_p );
+    Unit *NewUnit( const QString& name, const Dimension *dim_p );
+    QVector<Unit*> NewUnits( const QStringList& names, 
+        const Dimension *dim_p );
+    void Reserve( int dimension_count, int unit_count );
     Unit *GetUnit( const QString& name );
+    bool SetSymbol( Unit *unit_p, const QString& symbol );
+    bool AddAlias( const QString& alias, const Dimension *dim_p );
+    bool AddAlias( const QString& alias, const Unit *unit_p );
+    void Freeze();
 
 private:
-    UnitSystem();
+    explicit UnitSystem( const UnitSystem *base_p = NULL );
+
+    /// The system this is an overlay of, or NULL.
+    const UnitSystem *m_base_p;
+
+    /// True once Freeze() has been called. Overlays copy the base dimension
+    /// indices of their base, so a frozen system gets no new base dimensions.
+    bool m_frozen;
+
+    /// The fingerprint read from the snapshot the system was loaded from, or
+    /// empty if it must be computed.
+    QByteArray m_fingerprint;
+
+    /// The arena holding the dimensions, units and conversions. Once the 
+    /// system is frozen, the dimensions and units are in one block, with the
+    /// units grouped by dimension.
+    Util::Arena m_arena;
+
+    /// Maps normalized name atom -> dimension
+    QHash<Util::Atom,Dimension*> m_dimensions;
+
+    /// The dimensions, in the order they were added, or once the system is
+    /// frozen, in the order of the block. This owns the dimensions.
+    QVector<Dimension*> m_dimension_list;
+
+    /// Maps normalized alias atom -> dimension. For an overlay, the 
+    /// dimension may belong to the base system.
+    QHash<Util::Atom,const Dimension*> m_dimension_aliases;
+
+    const Dimension *FindDimension( Util::Atom key ) const;
+
+    /// Maps id -> dimension
+    QHash<DimensionId,Dimension*> m_dimension_ids;
+
+    const Dimension *FindDimension( const DimensionId& id ) const;
+
+    /// Maps packed id -> dimension
+    QHash<PackedDimensionId,Dimension*> m_packed_ids;
+
+    const Dimension *FindDimension( const PackedDimensionId& id ) const;
+    Dimension *OwnDimension( const Dimension *dim_p ) const;
+
+    /// Maps normalized base dimension id key -> base dimension index
+    QHash<QString,int> m_base_indices;
+
+    /// The base dimension id keys, by base dimension index.
+    QStringList m_base_keys;
+
+    bool Pack( const DimensionId& id, PackedDimensionId *packed_id_p );
+    Dimension *AddDimension( const QString& name, const DimensionId& id, 
+        const PackedDimensionId& packed_id );
+
+    /// The operations in the dimension algebra cache.
+    enum AlgebraOp { MultiplyOp, DivideOp };
+
+    /// A cached result of a dimension algebra operation. The sequence is odd
+    /// while the entry is being written and changes with every write, so a
+    /// reader can tell whether the fields it read belong together.
+    struct AlgebraEntry
+    {
+        AlgebraEntry() : 
+            lhs_p( NULL ), rhs_p( NULL ), op( MultiplyOp ), result_p( NULL )
+        {
+        }
+
+        /// The write sequence.
+        QAtomicInt sequence;
+        /// The left hand side, or NULL if the entry is empty.
+        const Dimension *lhs_p;
+        /// The right hand side.
+        const Dimension *rhs_p;
+        /// The operation.
+        AlgebraOp op;
+        /// The resulting dimension, or NULL if it isn't in the system.
+        const Dimension *result_p;
+    };
+
+    /// The number of slots in the dimension algebra cache, as a power of two.
+    enum { ALGEBRA_CACHE_BITS = 8 };
+
+    /// The dimension algebra cache. Each slot holds the most recent result
+    /// that hashed to it.
+    mutable AlgebraEntry m_algebra_cache[1 << ALGEBRA_CACHE_BITS];
+
+    const Dimension *Combine( const Dimension *lhs_p, const Dimension *rhs_p,
+        AlgebraOp op ) const;
+
+    void ClearCaches();
+    void ClearAlgebraCache();
+    void DestroyObjects();
+
+    /// Maps normalized name atom -> unit
+    QHash<Util::Atom,Unit*> m_units;
+
+    /// The units, in the order they were added, or once the system is 
+    /// frozen, in the order of the block. Units are never destroyed; their
+    /// memory is released with the arena.
+    QVector<Unit*> m_unit_list;
+
+    /// Maps normalized alias atom -> unit. For an overlay, the unit may 
+    /// belong to the base system.
+    QHash<Util::Atom,const Unit*> m_unit_aliases;
+
+    const Unit *FindUnit( Util::Atom key ) const;
+    Unit *OwnUnit( const Unit *unit_p ) const;
+
+    /// Maps symbol -> index in m_symbol_units.
+    Util::SymbolTrie m_symbols;
+
+    /// The units with symbols, in the order their symbols were set.
+    QVector<Unit*> m_symbol_units;
+
+    const Unit *FindSymbol( const QChar *begin_p, const QChar *end_p ) 
+        const;
+
+    /// Maps prefix symbol -> prefix index. Overlays use their base's.
+    Util::SymbolTrie m_prefix_symbols;
+
+    /// Maps normalized prefix name -> prefix index. Overlays use their 
+    /// base's.
+    Util::SymbolTrie m_prefix_names;
+
+    /// A prefixed unit looked up so far.
+    struct PrefixedEntry;
+
+    /// Maps (unit, prefix index) -> prefixed unit, for the prefixed units 
+    /// looked up so far. This owns the entries.
+    typedef QPair<const Unit*,int> PrefixedKey;
+    mutable QHash<PrefixedKey,PrefixedEntry*> m_prefixed_units;
+
+    /// Maps normalized name atom -> prefixed unit, for the names resolved
+    /// to prefixed units so far.
+    mutable QHash<Util::Atom,PrefixedEntry*> m_prefixed_names;
+
+    /// The arena holding the prefixed units and their conversions. Prefixed
+    /// units replaced after their unit was redefined stay in it, since 
+    /// readers may still be using them, until the caches are cleared.
+    mutable Util::Arena m_prefixed_arena;
+
+    /// Guards m_prefixed_units, m_prefixed_names and m_prefixed_arena, which
+    /// const lookups fill in.
+    mutable QMutex m_prefixed_mutex;
 
-    /// Maps name -> dimension
-    QHash<QString,Dimension*> m_dimensions;
+    /// The number of times dimensions, units or symbols have been added.
+    quint32 m_version;
 
-    /// Maps name -> unit
-    QHash<QString,Unit*> m_units;
+    const Unit *GetPrefixedUnit( const Unit *unit_p, int prefix, 
+        Util::Atom name_atom = 0 ) const;
+    const Unit *FindPrefixedName( Util::Atom key ) const;
+    const Unit *CurrentPrefixedUnit( PrefixedEntry *entry_p ) const;
 };
 
 } // namespace AutoUnits
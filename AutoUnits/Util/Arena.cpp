@@ -0,0 +1,109 @@
+//==============================================================================
+/// \file AutoUnits/Util/Arena.cpp
+///
+/// Source file for the AutoUnits::Util::Arena class.
+///
+//==============================================================================
+
+#include <algorithm>
+#include <new>
+
+#include "Util/Arena.h"
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// Constructor.
+///
+Arena::Arena() :
+    m_next_p( NULL ), m_end_p( NULL )
+{
+}
+
+//==============================================================================
+/// Destructor. Releases all of the arena's memory.
+///
+Arena::~Arena()
+{
+    for ( int i = 0; i < m_chunks.count(); ++i )
+    {
+        ::operator delete( m_chunks[i] );
+    }
+}
+
+//==============================================================================
+/// Allocate memory from the arena.
+///
+/// \param [in] size The number of bytes.
+///
+/// \return The memory, aligned for any of the library's objects.
+///
+void *Arena::Allocate( std::size_t size )
+{
+    size = Aligned( size );
+    Reserve( size );
+
+    void *result_p = m_next_p;
+    m_next_p += size;
+    return result_p;
+}
+
+//==============================================================================
+/// Make sure the next allocations of the given size don't need a new chunk.
+///
+/// \param [in] size The number of bytes in each allocation.
+/// \param [in] count The number of allocations.
+///
+void Arena::Reserve( std::size_t size, std::size_t count )
+{
+    size = count * Aligned( size );
+    if ( std::size_t( m_end_p - m_next_p ) < size )
+    {
+        NewChunk( std::max( std::size_t( CHUNK_SIZE ), size ) );
+    }
+}
+
+//==============================================================================
+/// Exchange the memory of two arenas.
+///
+/// \param [in] other The other arena.
+///
+void Arena::Swap( Arena& other )
+{
+    m_chunks.swap( other.m_chunks );
+    std::swap( m_next_p, other.m_next_p );
+    std::swap( m_end_p, other.m_end_p );
+}
+
+//==============================================================================
+/// Get the space an allocation takes up in an arena, so that callers can
+/// reserve room for several kinds of object at once.
+///
+/// \param [in] size The number of bytes allocated.
+///
+/// \return The number of bytes the allocation uses.
+///
+std::size_t Arena::Aligned( std::size_t size )
+{
+    return ( size + ALIGNMENT - 1 ) & ~std::size_t( ALIGNMENT - 1 );
+}
+
+//==============================================================================
+/// Start a new chunk. The rest of the last chunk is left unused.
+///
+/// \param [in] size The size of the chunk in bytes.
+///
+void Arena::NewChunk( std::size_t size )
+{
+    m_chunks.append( static_cast<char*>( ::operator new( size ) ) );
+    m_next_p = m_chunks.last();
+    m_end_p = m_next_p + size;
+}
+
+} // namespace Util
+
+} // namespace AutoUnits
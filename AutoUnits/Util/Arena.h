@@ -0,0 +1,70 @@
+#ifndef AUTO_UNITS_UTIL_ARENA_H
+#define AUTO_UNITS_UTIL_ARENA_H
+//==============================================================================
+/// \file AutoUnits/Util/Arena.h
+///
+/// Header file for the AutoUnits::Util::Arena class.
+///
+//==============================================================================
+
+#include <cstddef>
+
+#include <QList>
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// A region of memory that objects are allocated from by bumping a pointer.
+/// Memory is never returned to the arena one object at a time; it is all
+/// released at once when the arena is destroyed. Objects constructed in the
+/// arena must be destroyed by their owner before that, unless destroying 
+/// them would only free memory in the same arena, in which case they can 
+/// simply be abandoned.
+///
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+
+    void *Allocate( std::size_t size );
+    void Reserve( std::size_t size, std::size_t count = 1 );
+    void Swap( Arena& other );
+
+    static std::size_t Aligned( std::size_t size );
+
+private:
+    /// Not implemented.
+    Arena( const Arena& );
+    /// Not implemented.
+    Arena& operator=( const Arena& );
+
+    enum
+    {
+        /// The size of a chunk, unless a larger one is needed.
+        CHUNK_SIZE = 65536,
+        /// The alignment of every allocation.
+        ALIGNMENT = 16
+    };
+
+    void NewChunk( std::size_t size );
+
+    /// The chunks of memory.
+    QList<char*> m_chunks;
+
+    /// The next free byte in the last chunk.
+    char *m_next_p;
+
+    /// The end of the last chunk.
+    char *m_end_p;
+};
+
+} // namespace Util
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_ARENA_H
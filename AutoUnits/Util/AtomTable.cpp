@@ -0,0 +1,299 @@
+//==============================================================================
+/// \file AutoUnits/Util/AtomTable.cpp
+///
+/// Source file for the AutoUnits::Util::AtomTable class.
+///
+//==============================================================================
+
+#include <cassert>
+
+#include <QHash>
+#include <QMutexLocker>
+
+#include "Util/AtomTable.h"
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+Q_GLOBAL_STATIC( AtomTable, Instance )
+
+//==============================================================================
+/// An open addressing hash index of atoms. Each slot holds an atom, or zero
+/// if it is empty. The index is never more than half full, so every probe
+/// ends at an empty slot.
+///
+struct AtomTable::Index
+{
+    //==========================================================================
+    /// Constructor.
+    ///
+    /// \param [in] size The number of slots, a power of two.
+    ///
+    explicit Index( int size ) :
+        mask( uint( size - 1 ) ), slots_p( new QAtomicInt[size] )
+    {
+    }
+
+    //==========================================================================
+    /// Destructor.
+    ///
+    ~Index()
+    {
+        delete[] slots_p;
+    }
+
+    /// The number of slots, less one.
+    uint mask;
+    /// The slots.
+    QAtomicInt *slots_p;
+};
+
+//==============================================================================
+/// Constructor.
+///
+AtomTable::AtomTable() :
+    m_count( 0 ), m_chunk_used( 0 )
+{
+}
+
+//==============================================================================
+/// Destructor.
+///
+AtomTable::~AtomTable()
+{
+    for ( int i = 0; i < MAX_BLOCKS; ++i )
+    {
+        delete[] static_cast<Entry*>( m_blocks[i] );
+    }
+
+    qDeleteAll( m_indexes );
+
+    for ( int i = 0; i < m_chunks.count(); ++i )
+    {
+        delete[] m_chunks[i];
+    }
+}
+
+//==============================================================================
+/// Get the atom for a string, assigning one if the string hasn't been
+/// interned yet.
+///
+/// \param [in] text The string.
+///
+/// \return The atom.
+///
+Atom AtomTable::Intern( const QString& text )
+{
+    AtomTable *table_p = Instance();
+    const uint hash = qHash( text );
+
+    Atom atom = table_p->Lookup( text, hash );
+    if ( atom )
+    {
+        return atom;
+    }
+
+    QMutexLocker locker( &table_p->m_mutex );
+
+    // Another thread may have interned the string since it was looked up.
+    atom = table_p->Lookup( text, hash );
+    if ( atom )
+    {
+        return atom;
+    }
+
+    QString normalized( text.trimmed().toUpper() );
+    Atom normalized_atom = 0;
+    if ( normalized != text )
+    {
+        const uint normalized_hash = qHash( normalized );
+        normalized_atom = table_p->Lookup( normalized, normalized_hash );
+        if ( !normalized_atom )
+        {
+            normalized_atom = table_p->Add( normalized, normalized_hash, 0 );
+        }
+    }
+
+    return table_p->Add( text, hash, normalized_atom );
+}
+
+//==============================================================================
+/// Get the atom for a string without interning it.
+///
+/// \param [in] text The string.
+///
+/// \return The atom, or zero if the string hasn't been interned.
+///
+Atom AtomTable::Find( const QString& text )
+{
+    return Instance()->Lookup( text, qHash( text ) );
+}
+
+//==============================================================================
+/// Get the string an atom stands for.
+///
+/// \param [in] atom The atom.
+///
+/// \return The string, which refers to the table's storage.
+///
+QString AtomTable::Text( Atom atom )
+{
+    return Instance()->GetEntry( atom ).text;
+}
+
+//==============================================================================
+/// Get the atom for the normalized form of an atom's string: the string with
+/// the whitespace at either end removed, in upper case. This is how unit
+/// systems compare names, so names that differ only in case have the same
+/// normalized atom.
+///
+/// \param [in] atom The atom.
+///
+/// \return The normalized atom, which is the atom itself if its string is
+///         already normalized.
+///
+Atom AtomTable::Normalized( Atom atom )
+{
+    return Instance()->GetEntry( atom ).normalized;
+}
+
+//==============================================================================
+/// Get the entry for an atom.
+///
+/// \param [in] atom The atom.
+///
+/// \return The entry.
+///
+const AtomTable::Entry& AtomTable::GetEntry( Atom atom ) const
+{
+    assert( atom > 0 );
+
+    const int index = int( atom - 1 );
+    const Entry *block_p =
+        m_blocks[index >> BLOCK_BITS].fetchAndAddAcquire( 0 );
+    assert( block_p );
+    return block_p[index & ( ( 1 << BLOCK_BITS ) - 1 )];
+}
+
+//==============================================================================
+/// Look up the atom for a string. This doesn't lock.
+///
+/// \param [in] text The string.
+/// \param [in] hash The hash of the string.
+///
+/// \return The atom, or zero if the string hasn't been interned.
+///
+Atom AtomTable::Lookup( const QString& text, uint hash ) const
+{
+    // The acquires pair with the releases in Add() and Place(), so an atom
+    // found in the index has a complete entry.
+    const Index *index_p = m_index_p.fetchAndAddAcquire( 0 );
+    if ( !index_p )
+    {
+        return 0;
+    }
+
+    for ( uint i = hash & index_p->mask; ; i = ( i + 1 ) & index_p->mask )
+    {
+        const Atom atom = Atom( index_p->slots_p[i].fetchAndAddAcquire( 0 ) );
+        if ( !atom )
+        {
+            return 0;
+        }
+
+        const Entry& entry = GetEntry( atom );
+        if ( ( entry.hash == hash ) && ( entry.text == text ) )
+        {
+            return atom;
+        }
+    }
+}
+
+//==============================================================================
+/// Assign the next atom to a string. m_mutex must be held.
+///
+/// \param [in] text The string.
+/// \param [in] hash The hash of the string.
+/// \param [in] normalized The atom for the normalized string, or zero if
+///        the string is already normalized.
+///
+/// \return The atom.
+///
+Atom AtomTable::Add( const QString& text, uint hash, Atom normalized )
+{
+    const int index = m_count;
+    assert( ( index >> BLOCK_BITS ) < MAX_BLOCKS );
+
+    Entry *block_p = m_blocks[index >> BLOCK_BITS];
+    if ( !block_p )
+    {
+        block_p = new Entry[1 << BLOCK_BITS];
+        m_blocks[index >> BLOCK_BITS].fetchAndStoreRelease( block_p );
+    }
+
+    const int length = text.count();
+    if ( m_chunks.isEmpty() || ( m_chunk_used + length > CHUNK_SIZE ) )
+    {
+        m_chunks.append( new QChar[qMax( int( CHUNK_SIZE ), length )] );
+        m_chunk_used = 0;
+    }
+
+    QChar *chars_p = m_chunks.last() + m_chunk_used;
+    for ( int i = 0; i < length; ++i )
+    {
+        chars_p[i] = text[i];
+    }
+    m_chunk_used += length;
+
+    const Atom atom = Atom( ++m_count );
+    Entry& entry = block_p[index & ( ( 1 << BLOCK_BITS ) - 1 )];
+    entry.text = QString::fromRawData( chars_p, length );
+    entry.hash = hash;
+    entry.normalized = normalized ? normalized : atom;
+
+    // Readers can find the atom once it is placed in the current index, so
+    // a larger index must be complete before it is published.
+    Index *index_p = m_index_p;
+    if ( !index_p || ( 2 * m_count > int( index_p->mask + 1 ) ) )
+    {
+        index_p = new Index( index_p ?
+            2 * int( index_p->mask + 1 ) : int( INITIAL_INDEX_SIZE ) );
+        m_indexes.append( index_p );
+
+        for ( Atom i = 1; i <= atom; ++i )
+        {
+            Place( index_p, i );
+        }
+        m_index_p.fetchAndStoreRelease( index_p );
+    }
+    else
+    {
+        Place( index_p, atom );
+    }
+
+    return atom;
+}
+
+//==============================================================================
+/// Put an atom in an empty slot of a hash index. m_mutex must be held.
+///
+/// \param [in] index_p The index.
+/// \param [in] atom The atom.
+///
+void AtomTable::Place( Index *index_p, Atom atom )
+{
+    uint i = GetEntry( atom ).hash & index_p->mask;
+    while ( index_p->slots_p[i] != 0 )
+    {
+        i = ( i + 1 ) & index_p->mask;
+    }
+
+    index_p->slots_p[i].fetchAndStoreRelease( int( atom ) );
+}
+
+} // namespace Util
+
+} // namespace AutoUnits
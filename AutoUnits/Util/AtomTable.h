@@ -0,0 +1,112 @@
+#ifndef AUTO_UNITS_UTIL_ATOM_TABLE_H
+#define AUTO_UNITS_UTIL_ATOM_TABLE_H
+//==============================================================================
+/// \file AutoUnits/Util/AtomTable.h
+///
+/// Header file for the AutoUnits::Util::AtomTable class.
+///
+//==============================================================================
+
+#include <QAtomicPointer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+/// A small integer standing for an interned string. Equal strings have equal
+/// atoms. Zero is never assigned, so it can stand for no string.
+typedef quint32 Atom;
+
+//==============================================================================
+/// The process-wide table of interned strings. Each distinct string gets an
+/// atom the first time it is interned, and keeps it for the life of the
+/// process. The text of every atom is copied into large shared chunks that
+/// are never moved or freed, so the text is stored once however many
+/// systems use it.
+///
+/// The table only ever grows, so lookups don't lock: the entries are never
+/// moved, and a full hash index is replaced by a larger copy rather than
+/// rehashed in place. Only interning a new string takes a lock.
+///
+class AtomTable
+{
+public:
+    AtomTable();
+    ~AtomTable();
+
+    static Atom Intern( const QString& text );
+    static Atom Find( const QString& text );
+    static QString Text( Atom atom );
+    static Atom Normalized( Atom atom );
+
+private:
+    /// Not implemented.
+    AtomTable( const AtomTable& );
+    /// Not implemented.
+    AtomTable& operator=( const AtomTable& );
+
+    enum
+    {
+        /// The number of characters in a chunk, unless a longer string needs
+        /// a chunk of its own.
+        CHUNK_SIZE = 16384,
+        /// The number of entries in a block, as a power of two.
+        BLOCK_BITS = 12,
+        /// The most blocks the table can have.
+        MAX_BLOCKS = 4096,
+        /// The number of slots in the first hash index.
+        INITIAL_INDEX_SIZE = 1024
+    };
+
+    /// An interned string.
+    struct Entry
+    {
+        /// The text, which refers to the chunks.
+        QString text;
+        /// The hash of the text.
+        uint hash;
+        /// The atom for the normalized text.
+        Atom normalized;
+    };
+
+    /// An open addressing hash index of atoms.
+    struct Index;
+
+    const Entry& GetEntry( Atom atom ) const;
+    Atom Lookup( const QString& text, uint hash ) const;
+    Atom Add( const QString& text, uint hash, Atom normalized );
+    void Place( Index *index_p, Atom atom );
+
+    /// The blocks of entries, by ( atom - 1 ) >> BLOCK_BITS.
+    mutable QAtomicPointer<Entry> m_blocks[MAX_BLOCKS];
+
+    /// The number of atoms assigned.
+    int m_count;
+
+    /// The current hash index.
+    mutable QAtomicPointer<Index> m_index_p;
+
+    /// Every hash index created. Replaced indexes may still be in use by
+    /// readers, so they are only deleted with the table.
+    QList<Index*> m_indexes;
+
+    /// The chunks holding the text.
+    QList<QChar*> m_chunks;
+
+    /// The number of characters used in the last chunk.
+    int m_chunk_used;
+
+    /// Serializes interning.
+    QMutex m_mutex;
+};
+
+} // namespace Util
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_ATOM_TABLE_H
@@ -0,0 +1,240 @@
+//==============================================================================
+/// \file AutoUnits/Util/ConversionStream.cpp
+///
+/// Source file for the conversion serialization utilities.
+///
+//==============================================================================
+
+#include <QDataStream>
+
+#include "Types/Conversion.h"
+#include "Util/ConversionStream.h"
+
+namespace AutoUnits {
+namespace Conversions {
+
+namespace
+{
+
+//==============================================================================
+/// The tags written ahead of each node in the stream.
+///
+enum NodeTag
+{
+    ConstantTag,
+    ValueTag,
+    AddTag,
+    SubTag,
+    MultTag,
+    DivTag
+};
+
+/// The deepest conversion tree that may be read. Trees parsed from 
+/// definitions are far shallower; the limit keeps a damaged or hostile file
+/// from exhausting the stack.
+const int MAX_DEPTH = 64;
+
+/// The most nodes a single conversion read from a stream may have.
+const int MAX_NODES = 4096;
+
+//==============================================================================
+/// The visitor we use to write conversions. Nodes are written in prefix
+/// order: a tag followed by the node's payload or operands.
+///
+class ConversionWriter : public ConstVisitor
+{
+public:
+    //==========================================================================
+    /// Constructor.
+    ///
+    /// \param [in] out The stream to write to.
+    ///
+    ConversionWriter( QDataStream& out ) :
+        m_out( out )
+    {
+    }
+
+    //==========================================================================
+    /// Visit a constant node.
+    ///
+    /// \param [in] node The node to visit.
+    ///
+    virtual void Visit( const Constant& node )
+    {
+        m_out << quint8( ConstantTag ) << node.Value();
+    }
+
+    //==========================================================================
+    /// Visit a value node.
+    ///
+    virtual void Visit( const Value& )
+    {
+        m_out << quint8( ValueTag );
+    }
+
+    //==========================================================================
+    /// Visit an add node.
+    ///
+    /// \param [in] node The node to visit.
+    ///
+    virtual void Visit( const AddOp& node )
+    {
+        m_out << quint8( AddTag );
+        node.GetLeft()->Accept( *this );
+        node.GetRight()->Accept( *this );
+    }
+
+    //==========================================================================
+    /// Visit a sub node.
+    ///
+    /// \param [in] node The node to visit.
+    ///
+    virtual void Visit( const SubOp& node )
+    {
+        m_out << quint8( SubTag );
+        node.GetLeft()->Accept( *this );
+        node.GetRight()->Accept( *this );
+    }
+
+    //==========================================================================
+    /// Visit a mutliply node.
+    ///
+    /// \param [in] node The node to visit.
+    ///
+    virtual void Visit( const MultOp& node )
+    {
+        m_out << quint8( MultTag );
+        node.GetLeft()->Accept( *this );
+        node.GetRight()->Accept( *this );
+    }
+
+    //==========================================================================
+    /// Visit a div node.
+    ///
+    /// \param [in] node The node to visit.
+    ///
+    virtual void Visit( const DivOp& node )
+    {
+        m_out << quint8( DivTag );
+        node.GetLeft()->Accept( *this );
+        node.GetRight()->Accept( *this );
+    }
+
+private:
+    /// Not implemented.
+    ConversionWriter( const ConversionWriter& );
+    /// Not implemented.
+    ConversionWriter& operator=( const ConversionWriter& );
+
+    /// The output stream.
+    QDataStream& m_out;
+};
+
+//==============================================================================
+/// Read a single conversion node (and its operands) from the stream.
+///
+/// \param [in] in The stream.
+/// \param [in] depth The depth of the node in the tree.
+/// \param [in,out] nodes_p The number of nodes read so far for the tree.
+///
+/// \return The conversion, or NULL if the stream did not contain a valid
+///         conversion, or the tree was too deep or too large.
+///
+Conversion::AutoPtr ReadNode( QDataStream& in, int depth, int *nodes_p )
+{
+    if ( ( depth > MAX_DEPTH ) || ( ++*nodes_p > MAX_NODES ) )
+    {
+        in.setStatus( QDataStream::ReadCorruptData );
+        return Conversion::AutoPtr();
+    }
+
+    quint8 tag;
+    in >> tag;
+
+    if ( in.status() != QDataStream::Ok )
+    {
+        return Conversion::AutoPtr();
+    }
+
+    if ( tag == ConstantTag )
+    {
+        double value;
+        in >> value;
+        return Conversion::AutoPtr( new Constant( value ) );
+    }
+    else if ( tag == ValueTag )
+    {
+        return Conversion::AutoPtr( new Value );
+    }
+    else if ( tag > DivTag )
+    {
+        in.setStatus( QDataStream::ReadCorruptData );
+        return Conversion::AutoPtr();
+    }
+
+    Conversion::AutoPtr lhs_p( ReadNode( in, depth + 1, nodes_p ) );
+    if ( !lhs_p.get() )
+    {
+        return Conversion::AutoPtr();
+    }
+    Conversion::AutoPtr rhs_p( ReadNode( in, depth + 1, nodes_p ) );
+
+    if ( !lhs_p.get() || !rhs_p.get() )
+    {
+        return Conversion::AutoPtr();
+    }
+
+    switch ( tag )
+    {
+    case AddTag:
+        return Conversion::AutoPtr( new AddOp( lhs_p, rhs_p ) );
+    case SubTag:
+        return Conversion::AutoPtr( new SubOp( lhs_p, rhs_p ) );
+    case MultTag:
+        return Conversion::AutoPtr( new MultOp( lhs_p, rhs_p ) );
+    default:
+        return Conversion::AutoPtr( new DivOp( lhs_p, rhs_p ) );
+    }
+}
+
+} // namespace
+
+//==============================================================================
+/// Write the conversion to a binary stream.
+///
+/// \param [in] out The stream.
+/// \param [in] conv The conversion to write.
+///
+/// \return The stream.
+///
+QDataStream& operator<<( QDataStream& out, const Conversion& conv )
+{
+    ConversionWriter writer( out );
+    conv.Accept( writer );
+    return out;
+}
+
+//==============================================================================
+/// Read a conversion from a binary stream.
+///
+/// \param [in] in The stream.
+/// \param [out] conv_p The conversion read, or NULL if the stream was
+///        corrupt or the conversion was unreasonably deep or large (in 
+///        which case the stream's status is also set).
+///
+/// \return The stream.
+///
+QDataStream& operator>>( QDataStream& in, Conversion::AutoPtr& conv_p )
+{
+    int nodes = 0;
+    conv_p = ReadNode( in, 0, &nodes );
+
+    if ( !conv_p.get() && ( in.status() == QDataStream::Ok ) )
+    {
+        in.setStatus( QDataStream::ReadCorruptData );
+    }
+    return in;
+}
+
+} // namespace Conversions
+} // namespace AutoUnits
@@ -0,0 +1,25 @@
+#ifndef AUTO_UNITS_UTIL_CONVERSION_STREAM_H
+#define AUTO_UNITS_UTIL_CONVERSION_STREAM_H
+//==============================================================================
+/// \file AutoUnits/Util/ConversionStream.h
+///
+/// Binary serialization utilities for the conversion type.
+///
+//==============================================================================
+
+#include <memory>
+
+class QDataStream;
+
+namespace AutoUnits {
+namespace Conversions {
+
+class Conversion;
+
+QDataStream& operator<<( QDataStream& out, const Conversion& conv );
+QDataStream& operator>>( QDataStream& in, std::auto_ptr<Conversion>& conv_p );
+
+} // namespace Conversions
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_CONVERSION_STREAM_H
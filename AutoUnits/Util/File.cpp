@@ -0,0 +1,69 @@
+//==============================================================================
+/// \file AutoUnits/Util/File.cpp
+/// 
+/// Source file for the AutoUnits file utilities.
+///
+//==============================================================================
+
+#include <cstdio>
+
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+#include "Util/File.h"
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// Replace the contents of a file in one step. The contents are written to a
+/// temporary file next to it, which is then renamed over the file, so 
+/// readers see either the old file or the complete new one, and never a 
+/// partial file or no file at all.
+/// 
+/// \param [in] path The path of the file.
+/// \param [in] contents The new contents.
+/// 
+/// \return True if the file was replaced. The file is unchanged otherwise.
+/// 
+bool ReplaceFile( const QString& path, const QByteArray& contents )
+{
+    QString temp_path = path + ".tmp";
+    QFile file( temp_path );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ||
+        ( file.write( contents ) != contents.size() ) || !file.flush() )
+    {
+        file.close();
+        QFile::remove( temp_path );
+        return false;
+    }
+    file.close();
+
+#ifdef Q_OS_WIN
+    // rename() won't replace an existing file on Windows.
+    const bool renamed = MoveFileExW( 
+        reinterpret_cast<const wchar_t*>( temp_path.utf16() ), 
+        reinterpret_cast<const wchar_t*>( path.utf16() ), 
+        MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    const bool renamed = std::rename( 
+        QFile::encodeName( temp_path ).constData(), 
+        QFile::encodeName( path ).constData() ) == 0;
+#endif
+
+    if ( !renamed )
+    {
+        QFile::remove( temp_path );
+    }
+    return renamed;
+}
+
+} // namespace Util
+
+} // namespace AutoUnits
@@ -0,0 +1,25 @@
+#ifndef AUTO_UNITS_UTIL_FILE_H
+#define AUTO_UNITS_UTIL_FILE_H
+//==============================================================================
+/// \file AutoUnits/Util/File.h
+/// 
+/// Header file for the AutoUnits file utilities.
+///
+//==============================================================================
+
+#include <QByteArray>
+#include <QString>
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+bool ReplaceFile( const QString& path, const QByteArray& contents );
+
+} // namespace Util
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_FILE_H
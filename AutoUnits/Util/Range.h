@@ -0,0 +1,115 @@
+#ifndef AUTO_UNITS_UTIL_RANGE_H
+#define AUTO_UNITS_UTIL_RANGE_H
+//==============================================================================
+/// \file AutoUnits/Util/Range.h
+///
+/// Header file for the AutoUnits::Util::Range class.
+///
+//==============================================================================
+
+#include <cassert>
+#include <cstddef>
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// A read-only view of a contiguous array owned by another object. A range
+/// is two pointers, so it is cheap to copy, and iterating it never
+/// allocates. It is only valid until the array it views changes.
+///
+template<class T>
+class Range
+{
+public:
+    /// An iterator over the range.
+    typedef const T *const_iterator;
+
+    //==========================================================================
+    /// Constructor for an empty range.
+    ///
+    Range() :
+        m_begin_p( NULL ), m_end_p( NULL )
+    {
+    }
+
+    //==========================================================================
+    /// Constructor.
+    ///
+    /// \param [in] begin_p The first element.
+    /// \param [in] end_p One past the last element.
+    ///
+    Range( const T *begin_p, const T *end_p ) :
+        m_begin_p( begin_p ), m_end_p( end_p )
+    {
+        assert( begin_p <= end_p );
+    }
+
+    //==========================================================================
+    /// Get an iterator to the first element.
+    ///
+    /// \return The iterator.
+    ///
+    const_iterator begin() const
+    {
+        return m_begin_p;
+    }
+
+    //==========================================================================
+    /// Get an iterator to one past the last element.
+    ///
+    /// \return The iterator.
+    ///
+    const_iterator end() const
+    {
+        return m_end_p;
+    }
+
+    //==========================================================================
+    /// Get the number of elements.
+    ///
+    /// \return The number of elements.
+    ///
+    int count() const
+    {
+        return int( m_end_p - m_begin_p );
+    }
+
+    //==========================================================================
+    /// Check whether the range is empty.
+    ///
+    /// \return True if the range has no elements.
+    ///
+    bool isEmpty() const
+    {
+        return m_begin_p == m_end_p;
+    }
+
+    //==========================================================================
+    /// Get an element.
+    ///
+    /// \param [in] i The index of the element.
+    ///
+    /// \return The element.
+    ///
+    const T& operator[]( int i ) const
+    {
+        assert( ( i >= 0 ) && ( i < count() ) );
+        return m_begin_p[i];
+    }
+
+private:
+    /// The first element.
+    const T *m_begin_p;
+    /// One past the last element.
+    const T *m_end_p;
+};
+
+} // namespace Util
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_RANGE_H
@@ -0,0 +1,160 @@
+//==============================================================================
+/// \file AutoUnits/Util/SymbolTrie.cpp
+///
+/// Source file for the AutoUnits::Util::SymbolTrie class.
+///
+//==============================================================================
+
+#include <cassert>
+
+#include "Util/SymbolTrie.h"
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// Constructor.
+/// 
+SymbolTrie::SymbolTrie()
+{
+    Node root;
+    root.child = -1;
+    root.sibling = -1;
+    root.value = -1;
+    m_nodes.append( root );
+}
+
+//==============================================================================
+/// Add a symbol to the trie.
+/// 
+/// \param [in] symbol The symbol. This must not be empty.
+/// \param [in] value The value for the symbol. This must not be negative.
+/// 
+/// \return True if the symbol was added, false if it was already present.
+/// 
+bool SymbolTrie::Insert( const QString& symbol, int value )
+{
+    assert( !symbol.isEmpty() );
+    assert( value >= 0 );
+
+    int node = 0;
+    for ( int i = 0; i < symbol.count(); ++i )
+    {
+        int child = Child( node, symbol[i] );
+        if ( child < 0 )
+        {
+            Node new_node;
+            new_node.ch = symbol[i];
+            new_node.child = -1;
+            new_node.sibling = m_nodes[node].child;
+            new_node.value = -1;
+
+            child = m_nodes.count();
+            m_nodes.append( new_node );
+            m_nodes[node].child = child;
+        }
+        node = child;
+    }
+
+    if ( m_nodes[node].value >= 0 )
+    {
+        return false;
+    }
+
+    m_nodes[node].value = value;
+    return true;
+}
+
+//==============================================================================
+/// Find the value for a symbol.
+/// 
+/// \param [in] begin_p The first character of the symbol.
+/// \param [in] end_p One past the last character of the symbol.
+/// 
+/// \return The value, or -1 if the symbol isn't in the trie.
+/// 
+int SymbolTrie::Find( const QChar *begin_p, const QChar *end_p ) const
+{
+    if ( begin_p == end_p )
+    {
+        return -1;
+    }
+
+    int node = 0;
+    for ( const QChar *ch_p = begin_p; ( ch_p != end_p ) && ( node >= 0 ); 
+        ++ch_p )
+    {
+        node = Child( node, *ch_p );
+    }
+
+    return ( node >= 0 ) ? m_nodes[node].value : -1;
+}
+
+//==============================================================================
+/// Find every symbol in the trie that is a proper prefix of the given 
+/// string. The matches are reported from shortest to longest.
+/// 
+/// \param [in] begin_p The first character of the string.
+/// \param [in] end_p One past the last character of the string.
+/// \param [out] lengths_p The length of each match.
+/// \param [out] values_p The value of each match.
+/// \param [in] max The maximum number of matches to report.
+/// 
+/// \return The number of matches.
+/// 
+int SymbolTrie::FindPrefixes( const QChar *begin_p, const QChar *end_p, 
+    int *lengths_p, int *values_p, int max ) const
+{
+    int count = 0;
+    int node = 0;
+
+    for ( const QChar *ch_p = begin_p; ( ch_p + 1 < end_p ) && ( count < max );
+        ++ch_p )
+    {
+        node = Child( node, *ch_p );
+        if ( node < 0 )
+        {
+            break;
+        }
+
+        if ( m_nodes[node].value >= 0 )
+        {
+            lengths_p[count] = ch_p - begin_p + 1;
+            values_p[count] = m_nodes[node].value;
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+//==============================================================================
+/// Find the child of a node for the given character.
+/// 
+/// \param [in] node The index of the node.
+/// \param [in] ch The character.
+/// 
+/// \return The index of the child, or -1 if there is none.
+/// 
+int SymbolTrie::Child( int node, QChar ch ) const
+{
+    const Node *nodes_p = m_nodes.constData();
+
+    for ( int child = nodes_p[node].child; child >= 0; 
+        child = nodes_p[child].sibling )
+    {
+        if ( nodes_p[child].ch == ch )
+        {
+            return child;
+        }
+    }
+
+    return -1;
+}
+
+} // namespace Util
+
+} // namespace AutoUnits
@@ -0,0 +1,61 @@
+#ifndef AUTO_UNITS_UTIL_SYMBOL_TRIE_H
+#define AUTO_UNITS_UTIL_SYMBOL_TRIE_H
+//==============================================================================
+/// \file AutoUnits/Util/SymbolTrie.h
+///
+/// Header file for the AutoUnits::Util::SymbolTrie class.
+///
+//==============================================================================
+
+#include <QChar>
+#include <QString>
+#include <QVector>
+
+namespace AutoUnits
+{
+
+namespace Util
+{
+
+//==============================================================================
+/// A compact trie mapping short symbols to integer values. The nodes are 
+/// stored in a single array, so lookups only walk the array and never 
+/// allocate.
+/// 
+class SymbolTrie
+{
+public:
+    SymbolTrie();
+
+    bool Insert( const QString& symbol, int value );
+    int Find( const QChar *begin_p, const QChar *end_p ) const;
+    int FindPrefixes( const QChar *begin_p, const QChar *end_p, 
+        int *lengths_p, int *values_p, int max ) const;
+
+private:
+    //==========================================================================
+    /// A node in the trie.
+    /// 
+    struct Node
+    {
+        /// The character leading to the node from its parent.
+        QChar ch;
+        /// The index of the node's first child, or -1.
+        int child;
+        /// The index of the node's next sibling, or -1.
+        int sibling;
+        /// The value of the symbol ending at the node, or -1.
+        int value;
+    };
+
+    int Child( int node, QChar ch ) const;
+
+    /// The nodes. The root is always the first node.
+    QVector<Node> m_nodes;
+};
+
+} // namespace Util
+
+} // namespace AutoUnits
+
+#endif // AUTO_UNITS_UTIL_SYMBOL_TRIE_H
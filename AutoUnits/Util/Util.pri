@@ -1,9 +1,20 @@
 HEADERS += \
+    Util/Arena.h \
+    Util/AtomTable.h \
     Util/ConversionDebug.h \
+    Util/ConversionStream.h \
     Util/Error.h \
     Util/ExprParser.h \
+    Util/File.h \
+    Util/Range.h \
+    Util/SymbolTrie.h \
 
 SOURCES += \
+    Util/Arena.cpp \
+    Util/AtomTable.cpp \
     Util/ConversionDebug.cpp \
+    Util/ConversionStream.cpp \
     Util/Error.cpp \
+    Util/File.cpp \
+    Util/SymbolTrie.cpp \
 
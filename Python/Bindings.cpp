@@ -55,46 +55,25 @@ public:
 };
 
 template<class V>
-struct ListWrapper
+struct RangeWrapper
 {
-    typedef QList<const V*> T;
+    typedef Util::Range<const V*> T;
 
-    static void IndexError() { PyErr_SetString( PyExc_IndexError, "Index out of range"); }
-    static int Index( const T& self, int i )
+    static const V& get( const T& self, int i )
     {
         if ( i < 0 )
         {
-            i += self.size();
+            i += self.count();
         }
 
-        if ( i < 0 || i >= self.size() )
+        if ( i < 0 || i >= self.count() )
         {
-            IndexError();
+            PyErr_SetString( PyExc_IndexError, "Index out of range" );
+            throw_error_already_set();
         }
 
-        return i;
-    }
-
-    static const V& get( const T& self, int i )
-    {
-        return *self[Index( self, i )];
-    }
-
-    static void set( T& self, int i, const V& v )
-    {
-        self[Index( self, i )] = v;
-    }
-
-    static void del( T& self, int i )
-    {
-        self.erase( self.begin() + Index( self, i ) );
+        return *self[i];
     }
-
-    static void add( T& self, const V& v )
-    {
-        self.push_back( &v );
-    }
-
 };
 
 const UnitSystem *DefParserTakeResultWrapper( DefinitionParser *self_p )
@@ -119,18 +98,15 @@ BOOST_PYTHON_MODULE(AutoUnits)
     ;
 
     const Unit *(Dimension::*DimGetBaseUnit)() const = &Dimension::GetBaseUnit;
-    QList<const Unit*> (Dimension::*DimUnits)() const = &Dimension::Units;
     class_<Dimension, boost::noncopyable>( "Dimension", no_init )
         .def( "Name", &Dimension::Name )
         .def( "Id", &Dimension::Id )
         .def( "IsDerived", &Dimension::IsDerived )
         .def( "GetBaseUnit", DimGetBaseUnit, return_internal_reference<1>() )
-        .def( "Units", DimUnits, with_custodian_and_ward_postcall<1,0>() )
+        .def( "Units", &Dimension::UnitsView, 
+            with_custodian_and_ward_postcall<1,0>() )
     ;
 
-    QList<const Dimension*> (UnitSystem::*UsDimensions)() const = 
-        &UnitSystem::Dimensions;
-    QList<const Unit*> (UnitSystem::*UsUnits)() const = &UnitSystem::Units;
     const Dimension* 
         (UnitSystem::*UsGetDimensionById)(const DimensionId&) const = 
         &UnitSystem::GetDimension;
@@ -139,9 +115,10 @@ BOOST_PYTHON_MODULE(AutoUnits)
     const Unit * (UnitSystem::*UsGetUnit)(const QString&) const = 
         &UnitSystem::GetUnit;
     class_<UnitSystem, boost::noncopyable>( "UnitSystem", no_init )
-        .def( "Dimensions", UsDimensions, 
+        .def( "Dimensions", &UnitSystem::DimensionsView, 
+            with_custodian_and_ward_postcall<1,0>() )
+        .def( "Units", &UnitSystem::UnitsView, 
             with_custodian_and_ward_postcall<1,0>() )
-        .def( "Units", UsUnits, with_custodian_and_ward_postcall<1,0>() )
         .def( "GetDimension", UsGetDimensionById, 
             return_internal_reference<1>() )
         .def( "GetDimension", UsGetDimensionByName, 
@@ -155,10 +132,19 @@ BOOST_PYTHON_MODULE(AutoUnits)
             return_value_policy<manage_new_object>() )
     ;
 
-    typedef QList<const Dimension*> DimensionList;
-    class_<DimensionList>("DimensionList")
-        .def( "__len__", &DimensionList::size )
-        .def("__getitem__", &ListWrapper<Dimension>::get,
+    // The views refer to the system's own arrays, so iterating them from 
+    // Python doesn't copy the lists.
+    typedef UnitSystem::DimensionRange DimensionRange;
+    class_<DimensionRange>( "DimensionRange", no_init )
+        .def( "__len__", &DimensionRange::count )
+        .def( "__getitem__", &RangeWrapper<Dimension>::get,
+            return_value_policy<reference_existing_object>() )
+    ;
+
+    typedef UnitSystem::UnitRange UnitRange;
+    class_<UnitRange>( "UnitRange", no_init )
+        .def( "__len__", &UnitRange::count )
+        .def( "__getitem__", &RangeWrapper<Unit>::get,
             return_value_policy<reference_existing_object>() )
     ;
 
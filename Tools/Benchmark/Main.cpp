@@ -0,0 +1,141 @@
+//==============================================================================
+/// \file AutoUnits/Tools/Benchmark/Main.cpp
+///
+/// Contains the main function for the application, which times building,
+/// freezing and destroying synthetic unit systems of increasing size. The
+/// time per unit should stay flat as the systems grow, so the benchmark 
+/// fails if it grows by more than MAX_SLOWDOWN from the smallest system to
+/// the largest.
+///
+//==============================================================================
+
+#include <iostream>
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "AutoUnits/Dimension.h"
+#include "AutoUnits/Types/Conversion.h"
+#include "AutoUnits/Types/DimensionId.h"
+#include "AutoUnits/Unit.h"
+#include "AutoUnits/UnitSystem.h"
+
+using namespace AutoUnits;
+
+namespace
+{
+
+/// The number of dimensions the units are spread over.
+const int DIMENSION_COUNT = 16;
+
+/// The number of units in the largest system, unless given on the command
+/// line.
+const int DEFAULT_UNIT_COUNT = 1000000;
+
+/// The number of systems timed, each twice the size of the one before.
+const int STEP_COUNT = 4;
+
+/// The most the time per unit may grow from the smallest system to the 
+/// largest, as a factor. The systems differ in size by a factor of eight, so
+/// anything worse than linear in the number of units shows up well above 
+/// this.
+const double MAX_SLOWDOWN = 2.0;
+
+//==============================================================================
+/// Build a synthetic unit system.
+///
+/// \param [in] unit_count The number of units.
+///
+/// \return The system.
+///
+std::auto_ptr<UnitSystem> Build( int unit_count )
+{
+    std::auto_ptr<UnitSystem> system_p( UnitSystem::Create() );
+    system_p->Reserve( DIMENSION_COUNT + 1, unit_count + 1 );
+
+    const int per_dimension = unit_count / DIMENSION_COUNT;
+
+    for ( int i = 0; i < DIMENSION_COUNT; ++i )
+    {
+        QString dim_name( QString( "Quantity%1" ).arg( i ) );
+        Dimension *dim_p = system_p->NewDimension(
+            dim_name, DimensionId( dim_name + "Base" ) );
+
+        QStringList names;
+        names.reserve( per_dimension );
+        for ( int j = 0; j < per_dimension; ++j )
+        {
+            names << QString( "Instrument%1Unit%2" ).arg( i ).arg( j );
+        }
+
+        QVector<Unit*> units( system_p->NewUnits( names, dim_p ) );
+        dim_p->SetBaseUnit( units[0] );
+
+        for ( int j = 1; j < units.count(); ++j )
+        {
+            units[j]->SetToBase( Conversion::ScaleFactor( j + 1.0 ) );
+            units[j]->SetFromBase( Conversion::ScaleFactor( 1.0 / ( j + 1 ) ) );
+        }
+    }
+
+    return system_p;
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    int unit_count = DEFAULT_UNIT_COUNT;
+    if ( argc > 2 ||
+        ( argc == 2 && ( unit_count = QString( argv[1] ).toInt() ) <= 0 ) )
+    {
+        std::cerr << "Usage: " << argv[0] << " [unit count]" << std::endl;
+        return 2;
+    }
+
+    std::cout << "units\tbuild ns/unit\tfreeze ns/unit\tdestroy ns/unit"
+        << std::endl;
+
+    double smallest = 0.0;
+    double largest = 0.0;
+
+    for ( int step = STEP_COUNT - 1; step >= 0; --step )
+    {
+        const int count = unit_count >> step;
+        QElapsedTimer timer;
+
+        timer.start();
+        std::auto_ptr<UnitSystem> system_p( Build( count ) );
+        const qint64 build = timer.nsecsElapsed();
+
+        timer.restart();
+        system_p->Freeze();
+        const qint64 freeze = timer.nsecsElapsed();
+
+        timer.restart();
+        system_p.reset();
+        const qint64 destroy = timer.nsecsElapsed();
+
+        std::cout << count << "\t" << build / count << "\t"
+            << freeze / count << "\t" << destroy / count << std::endl;
+
+        largest = double( build + freeze + destroy ) / count;
+        if ( step == STEP_COUNT - 1 )
+        {
+            smallest = largest;
+        }
+    }
+
+    if ( largest > MAX_SLOWDOWN * smallest )
+    {
+        std::cerr << "Regression: " << largest << " ns/unit for the largest "
+            << "system against " << smallest << " ns/unit for the smallest."
+            << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
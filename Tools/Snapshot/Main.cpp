@@ -0,0 +1,49 @@
+//==============================================================================
+/// \file AutoUnits/Tools/Snapshot/Main.cpp
+/// 
+/// Contains the main function for the application, which compiles a unit
+/// definitions file to a unit system snapshot.
+///
+//==============================================================================
+
+#include <iostream>
+
+#include <QString>
+
+#include "AutoUnits/DefinitionParser.h"
+#include "AutoUnits/UnitSystem.h"
+
+using namespace AutoUnits;
+
+int main( int argc, char *argv[] )
+{
+    if ( argc != 3 )
+    {
+        std::cerr << "Usage: " << argv[0] << " <definitions> <snapshot>" 
+            << std::endl;
+        return 2;
+    }
+
+    DefinitionParser parser( QString::fromLocal8Bit( argv[1] ) );
+
+    QList<ParseError> errors( parser.Errors() );
+
+    for ( int i = 0; i < errors.count(); ++i )
+    {
+        std::cerr << QString( errors[i] ).toStdString() << std::endl;
+    }
+
+    std::auto_ptr<const UnitSystem> system_p( parser.TakeResult() );
+    if ( !system_p.get() )
+    {
+        return 1;
+    }
+
+    if ( !system_p->Save( QString::fromLocal8Bit( argv[2] ) ) )
+    {
+        std::cerr << "Unable to write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
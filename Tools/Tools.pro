@@ -1,6 +1,8 @@
 TEMPLATE = subdirs
 
 SUBDIRS = \
+    Benchmark \
     CodeGen \
+    Snapshot \
     UnitsGraph \
 
@@ -51,7 +51,7 @@ public:
             return;
         }
 
-        QList<const Unit*> other_units( dim.Units() );
+        Dimension::UnitRange other_units( dim.UnitsView() );
         for ( int i = 0; i < other_units.count(); ++i )
         {
             if ( &unit == other_units[i] )
@@ -80,19 +80,19 @@ public:
         out << "digraph UnitSystem {\n";
         out << Indent(1) << "rankdir=\"LR\";\n";
 
-        QList<const Unit*> units = system.Units();
+        UnitSystem::UnitRange units = system.UnitsView();
         for ( int i = 0; i < units.count(); ++i )
         {
             out << Indent(1) << units[i]->Name() << ";\n";
         }
 
-        QList<const Dimension*> dims = system.Dimensions();
+        UnitSystem::DimensionRange dims = system.DimensionsView();
         for ( int i = 0; i < dims.count(); ++i )
         {
             const Dimension *dim_p( dims[i] );
             out << Indent(1) << "subgraph cluster_" << dim_p->Name() << " {\n";
 
-            QList<const Unit*> units = dim_p->Units();
+            Dimension::UnitRange units = dim_p->UnitsView();
             for ( int j = 0; j < units.count(); ++j )
             {
                 Graph( out, *units[j] );